@@ -0,0 +1,177 @@
+#include "batch_render.h"
+#include "document_io.h"
+#include "soft_raster.h"
+
+#include <SFML/Graphics/Image.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+// Blank border around the drawing, as a fraction of its size.
+constexpr float THUMBNAIL_MARGIN = 0.02f;
+
+struct BatchOptions {
+    std::vector<sf::Vector2u> sizes;
+    unsigned int jobs = 0;
+    std::filesystem::path outputDirectory;
+    std::string format = "png";
+    std::vector<std::string> inputs;
+};
+
+void printUsage() {
+    std::cerr << "usage: paint --render [--size WxH]... [--jobs N] [--out DIR] [--format png|jpg|bmp|tga] FILE..."
+        << std::endl;
+}
+
+bool parseSize(const char* text, sf::Vector2u& size) {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    if (std::sscanf(text, "%ux%u", &width, &height) != 2 || width == 0 || height == 0) return false;
+    size = { width, height };
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, BatchOptions& options) {
+    for (int i = 0; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--size") == 0 && value) {
+            sf::Vector2u size;
+            if (!parseSize(value, size)) return false;
+            options.sizes.push_back(size);
+            ++i;
+        }
+        else if (std::strcmp(arg, "--jobs") == 0 && value) {
+            options.jobs = static_cast<unsigned int>(std::max(1, std::atoi(value)));
+            ++i;
+        }
+        else if (std::strcmp(arg, "--out") == 0 && value) {
+            options.outputDirectory = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--format") == 0 && value) {
+            options.format = value;
+            ++i;
+        }
+        else if (std::strncmp(arg, "--", 2) == 0) {
+            return false;
+        }
+        else {
+            options.inputs.push_back(arg);
+        }
+    }
+
+    if (options.sizes.empty()) options.sizes.push_back({ 256, 256 });
+    if (options.jobs == 0) options.jobs = std::max(1u, std::thread::hardware_concurrency());
+    return !options.inputs.empty();
+}
+
+// World rectangle that fits the whole drawing into an image of `size`,
+// centred and with the image's aspect ratio.
+sf::FloatRect fitArea(const Document& document, sf::Vector2u size) {
+    sf::Vector2f min(0.0f, 0.0f);
+    sf::Vector2f max(0.0f, 0.0f);
+    bool any = false;
+    auto grow = [&](const sf::FloatRect& bounds) {
+        sf::Vector2f end = bounds.position + bounds.size;
+        min = any ? sf::Vector2f(std::min(min.x, bounds.position.x), std::min(min.y, bounds.position.y)) : bounds.position;
+        max = any ? sf::Vector2f(std::max(max.x, end.x), std::max(max.y, end.y)) : end;
+        any = true;
+    };
+    for (std::uint32_t i = 0; i < document.lines.size(); ++i) grow(document.bounds({ ShapeKind::Line, i }));
+    for (std::uint32_t i = 0; i < document.rectangles.count(); ++i) grow(document.bounds({ ShapeKind::Rectangle, i }));
+    for (std::uint32_t i = 0; i < document.circles.count(); ++i) grow(document.bounds({ ShapeKind::Circle, i }));
+
+    sf::Vector2f extent = max - min;
+    extent = sf::Vector2f(std::max(extent.x, 1.0f), std::max(extent.y, 1.0f)) * (1.0f + 2.0f * THUMBNAIL_MARGIN);
+    float unitsPerPixel = std::max(extent.x / size.x, extent.y / size.y);
+    sf::Vector2f areaSize(size.x * unitsPerPixel, size.y * unitsPerPixel);
+    return sf::FloatRect((min + max) / 2.0f - areaSize / 2.0f, areaSize);
+}
+
+std::filesystem::path outputPath(const BatchOptions& options, const std::string& input, sf::Vector2u size) {
+    std::filesystem::path source(input);
+    std::filesystem::path directory = options.outputDirectory.empty() ? source.parent_path() : options.outputDirectory;
+    std::string name = source.stem().string() + "_" + std::to_string(size.x) + "x" + std::to_string(size.y) + "." +
+        options.format;
+    return directory / name;
+}
+}
+
+int runBatchRender(int argc, char** argv) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    if (!options.outputDirectory.empty()) {
+        std::error_code ignored;
+        std::filesystem::create_directories(options.outputDirectory, ignored);
+    }
+
+    // Whole documents are the unit of work, which scales best once there
+    // are more files than cores; with fewer files the spare cores go to
+    // the rasterizer's bands instead.
+    auto workerCount = static_cast<unsigned int>(std::min<std::size_t>(options.jobs, options.inputs.size()));
+    unsigned int bandThreads = std::max(1u, options.jobs / workerCount);
+
+    std::atomic<std::size_t> nextInput{ 0 };
+    std::atomic<std::size_t> rendered{ 0 };
+    std::atomic<std::size_t> failed{ 0 };
+    std::mutex logMutex;
+
+    auto worker = [&]() {
+        Document document;
+        SoftRasterizer rasterizer;
+        rasterizer.setThreadCount(bandThreads);
+        RasterImage image;
+        std::string error;
+
+        for (std::size_t i; (i = nextInput.fetch_add(1)) < options.inputs.size();) {
+            const std::string& input = options.inputs[i];
+            bool ok = loadDocument(input, document, error);
+
+            for (std::size_t s = 0; ok && s < options.sizes.size(); ++s) {
+                sf::Vector2u size = options.sizes[s];
+                image.resize(size.x, size.y);
+                rasterizer.render(document, fitArea(document, size), image);
+
+                std::filesystem::path path = outputPath(options, input, size);
+                if (!sf::Image(size, image.pixels.data()).saveToFile(path)) {
+                    error = "cannot write " + path.string();
+                    ok = false;
+                }
+            }
+
+            if (ok) {
+                ++rendered;
+            }
+            else {
+                ++failed;
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << error << std::endl;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < workerCount; ++i) pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Rendered " << rendered << " of " << options.inputs.size() << " documents in " << seconds << " s ("
+        << (seconds > 0.0 ? rendered / seconds : 0.0) << " documents/s, " << workerCount << " workers)" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
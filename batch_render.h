@@ -0,0 +1,8 @@
+#pragma once
+
+// Headless thumbnail renderer behind `paint --render`: loads documents,
+// rasterizes them on the CPU at the requested sizes and writes image files,
+// spreading documents across all cores. Returns the process exit code.
+//
+//   paint --render [--size WxH]... [--jobs N] [--out DIR] [--format png|jpg|bmp|tga] FILE...
+int runBatchRender(int argc, char** argv);
@@ -0,0 +1,372 @@
+// Headless rendering benchmark. Builds synthetic documents of lines,
+// rectangles and circles, renders them into an offscreen sf::RenderTexture
+// and prints the timings as JSON on stdout. It also times the ImGui layer
+// (a menu bar and the tool panel) with the backend's GL state tracking off
+// and on.
+//
+//   paint_bench [--frames N] [--sizes 10000,100000,1000000] [--width W] [--height H]
+//
+// On machines without a GPU, run it against Mesa's software driver, e.g.
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./paint_bench
+#include "imgui.h"
+#include "imgui-SFML.h"
+#include "document.h"
+#include "shape_batch.h"
+#include "shape_renderer.h"
+#include "spatial_index.h"
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+// Average spacing between shapes, so the shape density stays the same at
+// every document size.
+constexpr float WORLD_UNITS_PER_SHAPE = 40.0f;
+constexpr unsigned int SEED = 12345;
+// A UI frame takes well under a millisecond, so it is timed over many more
+// frames than the scene.
+constexpr int UI_FRAMES_PER_FRAME = 50;
+
+struct Options {
+    int frames = 20;
+    unsigned int width = 1920;
+    unsigned int height = 1080;
+    std::vector<std::size_t> sizes{ 10000, 100000, 1000000 };
+};
+
+struct Scene {
+    Document document;
+    ShapeBatches batches;
+    SpatialIndex spatialIndex;
+    std::vector<ShapeHandle> allShapes;
+    float worldSize = 0.0f;
+};
+
+struct Result {
+    std::size_t shapes;
+    const char* mode;
+    std::size_t drawnShapes;
+    double setupMs;
+    double msPerFrame;
+    double shapesPerSecond;
+    std::size_t peakBytes;
+};
+
+struct UiResult {
+    double backupMsPerFrame;
+    double trackedMsPerFrame;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+std::size_t peakMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+sf::Color randomColor(std::mt19937& random) {
+    std::uniform_int_distribution<int> channel(0, 255);
+    auto next = [&]() { return static_cast<std::uint8_t>(channel(random)); };
+    return sf::Color(next(), next(), next());
+}
+
+// An even mix of lines, rectangles and circles scattered over a square world.
+void buildScene(Scene& scene, std::size_t shapeCount) {
+    std::mt19937 random(SEED);
+    scene.worldSize = std::sqrt(static_cast<float>(shapeCount)) * WORLD_UNITS_PER_SHAPE;
+    std::uniform_real_distribution<float> coord(0.0f, scene.worldSize);
+    std::uniform_real_distribution<float> extent(4.0f, 40.0f);
+    std::uniform_real_distribution<float> thickness(1.0f, 6.0f);
+    std::uniform_int_distribution<int> filled(0, 1);
+
+    Document& document = scene.document;
+    for (std::size_t i = 0; i < shapeCount; ++i) {
+        sf::Vector2f position(coord(random), coord(random));
+        switch (i % 3) {
+        case 0: {
+            Line line;
+            line.start = position;
+            line.end = position + sf::Vector2f(extent(random), extent(random));
+            line.firstColor = randomColor(random);
+            line.secondColor = randomColor(random);
+            line.thickness = thickness(random);
+            ShapeHandle shape = document.add(line);
+            scene.spatialIndex.insert(shape, lineBounds(line));
+            break;
+        }
+        case 1: {
+            RectangleData rectangle;
+            rectangle.position = position;
+            rectangle.size = sf::Vector2f(extent(random), extent(random));
+            rectangle.fillColor = filled(random) ? randomColor(random) : sf::Color::Transparent;
+            rectangle.outlineColor = randomColor(random);
+            rectangle.outlineThickness = thickness(random);
+            ShapeHandle shape = document.add(rectangle);
+            scene.spatialIndex.insert(shape, document.bounds(*document.find(shape)));
+            break;
+        }
+        default: {
+            CircleData circle;
+            circle.center = position;
+            circle.radius = extent(random);
+            circle.outlineColor = randomColor(random);
+            circle.outlineThickness = thickness(random);
+            ShapeHandle shape = document.add(circle);
+            scene.spatialIndex.insert(shape, document.bounds(*document.find(shape)));
+            break;
+        }
+        }
+    }
+
+    scene.allShapes.reserve(shapeCount);
+    for (std::size_t k = 0; k < SHAPE_KIND_COUNT; ++k) {
+        auto kind = static_cast<ShapeKind>(k);
+        for (std::uint32_t i = 0; i < document.count(kind); ++i) scene.allShapes.push_back(document.handleOf({ kind, i }));
+    }
+    document.sortByDepth(scene.allShapes);
+}
+
+// Renders `frames` frames of `view` and returns the average time per frame.
+// With `cull` set the visible shapes are looked up in the spatial index every
+// frame, as the app does; otherwise everything is submitted.
+double renderFrames(sf::RenderTexture& target, Scene& scene, ShapeRenderer& renderer, const sf::View& view,
+    bool cull, int frames, std::size_t& drawnShapes) {
+    sf::FloatRect area(view.getCenter() - view.getSize() / 2.0f, view.getSize());
+    renderer.setScale(static_cast<float>(target.getSize().x) / view.getSize().x);
+    target.setView(view);
+
+    std::vector<ShapeHandle> visible;
+    auto renderOnce = [&]() {
+        target.clear(sf::Color::White);
+        if (cull) {
+            visible.clear();
+            scene.spatialIndex.queryRect(area, visible);
+            scene.document.sortByDepth(visible);
+            renderer.draw(target, scene.document, scene.batches, visible);
+            drawnShapes = visible.size();
+        }
+        else {
+            renderer.draw(target, scene.document, scene.batches, scene.allShapes);
+            drawnShapes = scene.allShapes.size();
+        }
+        target.display();
+        // Wait for the driver so the time covers rasterization, not just submission.
+        glFinish();
+    };
+
+    renderOnce();
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frames; ++frame) renderOnce();
+    return elapsedMs(start) / frames;
+}
+
+// Headless stand-in for ImGui::SFML::Init(), which needs a window.
+void initUi(sf::Vector2u size, sf::Texture& fontTexture) {
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(static_cast<float>(size.x), static_cast<float>(size.y));
+    io.DeltaTime = 1.0f / 60.0f;
+
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    if (fontTexture.resize({ static_cast<unsigned int>(width), static_cast<unsigned int>(height) })) {
+        fontTexture.update(pixels);
+    }
+    io.Fonts->SetTexID(static_cast<ImTextureID>(fontTexture.getNativeHandle()));
+}
+
+// Roughly what the app shows while drawing: the menu bar and the tool panel.
+void buildUi() {
+    if (ImGui::BeginMainMenuBar()) {
+        for (const char* menu : { "File", "Edit", "View", "Help" }) {
+            if (ImGui::BeginMenu(menu)) ImGui::EndMenu();
+        }
+        ImGui::EndMainMenuBar();
+    }
+
+    static int tool = 0;
+    static float brushSize = 5.0f;
+    static float borderColor[3] = { 1.f, 0.2f, 0.3f };
+    static float fillColor[3] = { 1.f, 0.2f, 0.3f };
+    ImGui::SetNextWindowPos(ImVec2(20, 60), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(260, 200), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Tools")) {
+        ImGui::TextUnformatted("Tool Options");
+        ImGui::Separator();
+        ImGui::RadioButton("Line", &tool, 0);
+        ImGui::RadioButton("Rectangle", &tool, 1);
+        ImGui::RadioButton("Filled Rectangle", &tool, 2);
+        ImGui::RadioButton("Circle", &tool, 3);
+        ImGui::RadioButton("Select", &tool, 4);
+        ImGui::SliderFloat("Brush Size", &brushSize, 1.0f, 100.0f);
+        ImGui::Separator();
+        ImGui::ColorEdit3("Border Color", borderColor);
+        ImGui::ColorEdit3("Fill Color", fillColor);
+    }
+    ImGui::End();
+}
+
+// Average time ImGui::SFML::Render() takes per frame, with the backend's
+// GL state tracking set to `stateTracking`.
+double renderUiFrames(sf::RenderTexture& target, bool stateTracking, int frames) {
+    ImGui::SFML::SetGLStateTracking(stateTracking);
+    double totalMs = 0.0;
+    for (int frame = -1; frame < frames; ++frame) {
+        ImGui::NewFrame();
+        buildUi();
+        Clock::time_point start = Clock::now();
+        ImGui::SFML::Render(target);
+        glFinish();
+        // Frame -1 warms up the font atlas and the stream buffers.
+        if (frame >= 0) totalMs += elapsedMs(start);
+    }
+    ImGui::SFML::SetGLStateTracking(true);
+    return totalMs / frames;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--frames") == 0 && value) {
+            options.frames = std::max(1, std::atoi(value));
+        }
+        else if (std::strcmp(arg, "--width") == 0 && value) {
+            options.width = static_cast<unsigned int>(std::max(1, std::atoi(value)));
+        }
+        else if (std::strcmp(arg, "--height") == 0 && value) {
+            options.height = static_cast<unsigned int>(std::max(1, std::atoi(value)));
+        }
+        else if (std::strcmp(arg, "--sizes") == 0 && value) {
+            options.sizes.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) options.sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+            }
+        }
+        else {
+            return false;
+        }
+        ++i;
+    }
+    return !options.sizes.empty();
+}
+
+void printJson(const Options& options, const std::vector<Result>& results, const UiResult& ui) {
+    std::printf("{\n  \"frames\": %d,\n  \"width\": %u,\n  \"height\": %u,\n", options.frames, options.width,
+        options.height);
+    std::printf("  \"renderer\": \"%s\",\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    std::printf("  \"results\": [\n");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("    {\"shapes\": %zu, \"mode\": \"%s\", \"drawnShapes\": %zu, \"setupMs\": %.3f, "
+            "\"msPerFrame\": %.3f, \"shapesPerSecond\": %.0f, \"peakMemoryBytes\": %zu}%s\n",
+            r.shapes, r.mode, r.drawnShapes, r.setupMs, r.msPerFrame, r.shapesPerSecond, r.peakBytes,
+            i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ],\n");
+    std::printf("  \"ui\": {\"backupMsPerFrame\": %.4f, \"trackedMsPerFrame\": %.4f, \"savedMsPerFrame\": %.4f}\n}\n",
+        ui.backupMsPerFrame, ui.trackedMsPerFrame, ui.backupMsPerFrame - ui.trackedMsPerFrame);
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: paint_bench [--frames N] [--sizes a,b,c] [--width W] [--height H]" << std::endl;
+        return 2;
+    }
+
+    sf::RenderTexture target;
+    if (!target.resize({ options.width, options.height })) {
+        std::cerr << "Could not create a " << options.width << "x" << options.height << " render texture" << std::endl;
+        return 1;
+    }
+    if (!target.setActive(true)) {
+        std::cerr << "Could not activate the OpenGL context" << std::endl;
+        return 1;
+    }
+
+    // Sizes are run smallest first so the process-wide peak memory reading
+    // belongs to the largest document built so far.
+    std::sort(options.sizes.begin(), options.sizes.end());
+
+    std::vector<Result> results;
+    for (std::size_t size : options.sizes) {
+        Clock::time_point setupStart = Clock::now();
+        Scene scene;
+        buildScene(scene, size);
+        double setupMs = elapsedMs(setupStart);
+        ShapeRenderer renderer;
+
+        // The whole document squeezed into the target, then a 1:1 viewport
+        // in the middle of it, which is what the app draws at default zoom.
+        float aspect = static_cast<float>(options.height) / static_cast<float>(options.width);
+        sf::Vector2f worldCenter(scene.worldSize / 2.0f, scene.worldSize / 2.0f);
+        sf::View fullView(worldCenter, sf::Vector2f(scene.worldSize, scene.worldSize * aspect));
+        sf::View viewport(worldCenter, sf::Vector2f(static_cast<float>(options.width), static_cast<float>(options.height)));
+
+        struct Mode {
+            const char* name;
+            const sf::View& view;
+            bool cull;
+        };
+        for (const Mode& mode : { Mode{ "full", fullView, false }, Mode{ "viewport", viewport, true } }) {
+            std::size_t drawnShapes = 0;
+            double msPerFrame = renderFrames(target, scene, renderer, mode.view, mode.cull, options.frames, drawnShapes);
+            double shapesPerSecond = msPerFrame > 0.0 ? drawnShapes * 1000.0 / msPerFrame : 0.0;
+            results.push_back({ size, mode.name, drawnShapes, setupMs, msPerFrame, shapesPerSecond, peakMemoryBytes() });
+        }
+    }
+
+    sf::Texture fontTexture;
+    initUi(target.getSize(), fontTexture);
+    int uiFrames = options.frames * UI_FRAMES_PER_FRAME;
+    UiResult ui;
+    ui.backupMsPerFrame = renderUiFrames(target, false, uiFrames);
+    ui.trackedMsPerFrame = renderUiFrames(target, true, uiFrames);
+    ImGui::DestroyContext();
+
+    printJson(options, results, ui);
+    return 0;
+}
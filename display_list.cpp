@@ -0,0 +1,237 @@
+#include "display_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+constexpr std::uint64_t MAX_DEPTH = std::numeric_limits<std::uint64_t>::max();
+// Gap left between shapes added on top or at the bottom, and between
+// shapes given their default order.
+constexpr std::uint64_t DEPTH_SPACING = std::uint64_t(1) << 24;
+// Default labels start here, leaving room below for sending shapes back.
+constexpr std::uint64_t DEPTH_BASE = std::uint64_t(1) << 62;
+// A label range of 2^k values is sparse enough to relabel when it holds
+// fewer than (2 / DENSITY_BASE)^k shapes. Between 1 and 2; lower values
+// relabel less often but in larger ranges. 1.4 still allows 2^32 shapes.
+constexpr double DENSITY_BASE = 1.4;
+}
+
+void DisplayList::sort(std::vector<ShapeRef>& shapes) const {
+    std::sort(shapes.begin(), shapes.end(), [this](ShapeRef a, ShapeRef b) { return depthOf(a) < depthOf(b); });
+}
+
+void DisplayList::pushFront(ShapeKind kind) {
+    ensureLinked();
+    std::size_t k = kindIndex(kind);
+    Node node = pack({ kind, static_cast<std::uint32_t>(depths[k].size()) });
+    depths[k].push_back(0);
+    previousLinks[k].push_back(NONE);
+    nextLinks[k].push_back(NONE);
+    link(node, topNode);
+    assignDepth(node);
+}
+
+void DisplayList::erase(ShapeRef shape) {
+    ensureLinked();
+    std::size_t k = kindIndex(shape.kind);
+    Node node = pack(shape);
+    unlink(node);
+
+    // The last shape moves into the freed index; its neighbours follow.
+    Node moved = pack({ shape.kind, static_cast<std::uint32_t>(depths[k].size() - 1) });
+    if (moved != node) {
+        depth(node) = depth(moved);
+        Node after = previous(node) = previous(moved);
+        Node before = next(node) = next(moved);
+        if (after == NONE) bottomNode = node;
+        else next(after) = node;
+        if (before == NONE) topNode = node;
+        else previous(before) = node;
+    }
+    depths[k].pop_back();
+    previousLinks[k].pop_back();
+    nextLinks[k].pop_back();
+}
+
+void DisplayList::place(ShapeRef shape, std::optional<ShapeRef> below) {
+    ensureLinked();
+    Node node = pack(shape);
+    Node after = below ? pack(*below) : NONE;
+    if (after == node || previous(node) == after) return;
+
+    unlink(node);
+    link(node, after);
+    assignDepth(node);
+}
+
+std::optional<ShapeRef> DisplayList::below(ShapeRef shape) {
+    ensureLinked();
+    Node node = previous(pack(shape));
+    if (node == NONE) return std::nullopt;
+    return unpack(node);
+}
+
+std::optional<ShapeRef> DisplayList::top() {
+    ensureLinked();
+    if (topNode == NONE) return std::nullopt;
+    return unpack(topNode);
+}
+
+void DisplayList::clear() {
+    for (std::size_t k = 0; k < SHAPE_KIND_COUNT; ++k) {
+        depths[k].clear();
+        previousLinks[k].clear();
+        nextLinks[k].clear();
+    }
+    bottomNode = topNode = NONE;
+    linked = false;
+}
+
+void DisplayList::detach() {
+    for (PodArray<std::uint64_t>& labels : depths) labels.detach();
+}
+
+std::size_t DisplayList::bytesUsed() const {
+    std::size_t bytes = 0;
+    for (std::size_t k = 0; k < SHAPE_KIND_COUNT; ++k) {
+        bytes += depths[k].capacity() * sizeof(std::uint64_t);
+        bytes += (previousLinks[k].capacity() + nextLinks[k].capacity()) * sizeof(Node);
+    }
+    return bytes;
+}
+
+std::uint64_t& DisplayList::depth(Node node) {
+    ShapeRef shape = unpack(node);
+    return depths[kindIndex(shape.kind)].mutableData()[shape.index];
+}
+
+DisplayList::Node& DisplayList::previous(Node node) {
+    ShapeRef shape = unpack(node);
+    return previousLinks[kindIndex(shape.kind)].mutableData()[shape.index];
+}
+
+DisplayList::Node& DisplayList::next(Node node) {
+    ShapeRef shape = unpack(node);
+    return nextLinks[kindIndex(shape.kind)].mutableData()[shape.index];
+}
+
+void DisplayList::ensureLinked() {
+    if (linked) return;
+
+    std::vector<std::pair<std::uint64_t, Node>> order;
+    for (std::size_t k = 0; k < SHAPE_KIND_COUNT; ++k) {
+        for (std::uint32_t i = 0; i < depths[k].size(); ++i) {
+            order.push_back({ depths[k][i], pack({ static_cast<ShapeKind>(k), i }) });
+        }
+        previousLinks[k].resize(depths[k].size());
+        nextLinks[k].resize(depths[k].size());
+    }
+    std::sort(order.begin(), order.end());
+
+    Node last = NONE;
+    for (const auto& entry : order) {
+        previous(entry.second) = last;
+        if (last != NONE) next(last) = entry.second;
+        last = entry.second;
+    }
+    if (last != NONE) next(last) = NONE;
+    bottomNode = order.empty() ? NONE : order.front().second;
+    topNode = last;
+    linked = true;
+}
+
+// Inserts `node` right after `after`, or at the bottom.
+void DisplayList::link(Node node, Node after) {
+    Node before = after == NONE ? bottomNode : next(after);
+    previous(node) = after;
+    next(node) = before;
+    if (after == NONE) bottomNode = node;
+    else next(after) = node;
+    if (before == NONE) topNode = node;
+    else previous(before) = node;
+}
+
+void DisplayList::unlink(Node node) {
+    Node after = previous(node);
+    Node before = next(node);
+    if (after == NONE) bottomNode = before;
+    else next(after) = before;
+    if (before == NONE) topNode = after;
+    else previous(before) = after;
+}
+
+// Gives a freshly linked node a label between its neighbours'.
+void DisplayList::assignDepth(Node node) {
+    Node below = previous(node);
+    Node above = next(node);
+    std::uint64_t label;
+    bool fits;
+    if (below == NONE && above == NONE) {
+        label = DEPTH_BASE;
+        fits = true;
+    }
+    else if (above == NONE) {
+        std::uint64_t lower = depth(below);
+        label = MAX_DEPTH - lower > DEPTH_SPACING ? lower + DEPTH_SPACING : lower + (MAX_DEPTH - lower) / 2;
+        fits = label > lower;
+    }
+    else if (below == NONE) {
+        std::uint64_t upper = depth(above);
+        label = upper > DEPTH_SPACING ? upper - DEPTH_SPACING : upper / 2;
+        fits = label < upper;
+    }
+    else {
+        std::uint64_t lower = depth(below);
+        label = lower + (depth(above) - lower) / 2;
+        fits = label > lower;
+    }
+
+    if (fits) {
+        depth(node) = label;
+        return;
+    }
+    // Borrow a neighbour's label so the list stays sorted, then make room.
+    depth(node) = below != NONE ? depth(below) : depth(above);
+    relabelAround(node);
+}
+
+// Spreads the labels of the smallest aligned range around `node` that is
+// sparse enough evenly across that range.
+void DisplayList::relabelAround(Node node) {
+    std::uint64_t center = depth(node);
+    Node first = node;
+    Node last = node;
+    std::size_t count = 1;
+
+    for (int level = 2; level <= 64; ++level) {
+        std::uint64_t low = 0;
+        std::uint64_t high = MAX_DEPTH;
+        if (level < 64) {
+            std::uint64_t size = std::uint64_t(1) << level;
+            low = center & ~(size - 1);
+            high = low + (size - 1);
+        }
+        while (previous(first) != NONE && depth(previous(first)) >= low) {
+            first = previous(first);
+            ++count;
+        }
+        while (next(last) != NONE && depth(next(last)) <= high) {
+            last = next(last);
+            ++count;
+        }
+
+        double capacity = std::pow(2.0 / DENSITY_BASE, level);
+        if ((count < capacity && count + 1 < high - low) || level == 64) {
+            std::uint64_t step = (high - low) / (count + 1);
+            std::uint64_t label = low;
+            for (Node n = first;; n = next(n)) {
+                label += step;
+                depth(n) = label;
+                if (n == last) break;
+            }
+            return;
+        }
+    }
+}
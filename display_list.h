@@ -0,0 +1,72 @@
+#pragma once
+
+#include "pod_array.h"
+#include "shapes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Draw order across every shape kind, bottom to top. Each shape carries a
+// 64-bit depth label, and sorting by depth gives the draw order, so any
+// subset of shapes (a spatial query, say) can be put in order without
+// walking the whole list. Labels are spaced out, and a move normally takes
+// the midpoint of its new neighbours' labels. When a gap runs out, the
+// smallest aligned label range around the move that is sparse enough gets
+// relabelled evenly (the classic order-maintenance scheme). Moves therefore
+// cost amortized O(log n).
+//
+// Only the labels are part of the saved document. The neighbour links that
+// moves need are rebuilt from them on the first edit, so documents that
+// are only read (batch rendering, say) never pay for them.
+class DisplayList {
+public:
+    // Depth labels, indexed by ShapeKind and then by shape index.
+    PodArray<std::uint64_t> depths[SHAPE_KIND_COUNT];
+
+    PodArray<std::uint64_t>& depthsOf(ShapeKind kind) { return depths[kindIndex(kind)]; }
+    const PodArray<std::uint64_t>& depthsOf(ShapeKind kind) const { return depths[kindIndex(kind)]; }
+    std::uint64_t depthOf(ShapeRef shape) const { return depths[kindIndex(shape.kind)][shape.index]; }
+    // Sorts `shapes` bottom to top.
+    void sort(std::vector<ShapeRef>& shapes) const;
+
+    // Puts a just-added shape, the last of its kind, on top.
+    void pushFront(ShapeKind kind);
+    // Forgets `shape`; the last shape of its kind takes its index, as in
+    // the document's arrays.
+    void erase(ShapeRef shape);
+    // Moves `shape` directly above `below`, or to the very bottom.
+    void place(ShapeRef shape, std::optional<ShapeRef> below);
+    std::optional<ShapeRef> below(ShapeRef shape);
+    std::optional<ShapeRef> top();
+
+    void clear();
+    void detach();
+    std::size_t bytesUsed() const;
+
+private:
+    // A shape packed into 32 bits: kind in the top two, index below.
+    using Node = std::uint32_t;
+    static constexpr Node NONE = 0xFFFFFFFFu;
+
+    static std::size_t kindIndex(ShapeKind kind) { return static_cast<std::size_t>(kind); }
+    static Node pack(ShapeRef shape) { return static_cast<Node>(shape.kind) << 30 | shape.index; }
+    static ShapeRef unpack(Node node) { return { static_cast<ShapeKind>(node >> 30), node & 0x3FFFFFFFu }; }
+
+    std::uint64_t& depth(Node node);
+    Node& previous(Node node);
+    Node& next(Node node);
+
+    void ensureLinked();
+    void link(Node node, Node after);
+    void unlink(Node node);
+    void assignDepth(Node node);
+    void relabelAround(Node node);
+
+    PodArray<Node> previousLinks[SHAPE_KIND_COUNT];
+    PodArray<Node> nextLinks[SHAPE_KIND_COUNT];
+    Node bottomNode = NONE;
+    Node topNode = NONE;
+    bool linked = false;
+};
@@ -0,0 +1,263 @@
+#include "document.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+template <typename T>
+std::size_t capacityBytes(const PodArray<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+// sf::Shape caches a triangle fan with pointCount + 2 vertices and an
+// outline strip with (pointCount + 1) * 2 vertices.
+std::size_t sfmlShapeBytes(std::size_t objectSize, std::size_t pointCount) {
+    std::size_t cachedVertices = (pointCount + 2) + (pointCount + 1) * 2;
+    return objectSize + cachedVertices * sizeof(sf::Vertex);
+}
+
+// Stores `shape` as the last of its kind and puts it on top.
+void append(Document& document, const ShapeData& shape) {
+    if (const Line* line = std::get_if<Line>(&shape)) {
+        document.lines.push_back(*line);
+    }
+    else if (const RectangleData* r = std::get_if<RectangleData>(&shape)) {
+        document.rectangles.add(r->position, r->size, r->fillColor, r->outlineColor, r->outlineThickness);
+    }
+    else if (const CircleData* c = std::get_if<CircleData>(&shape)) {
+        document.circles.add(c->center, c->radius, c->outlineColor, c->outlineThickness);
+    }
+    document.order.pushFront(shapeKind(shape));
+}
+}
+
+void RectangleStore::add(sf::Vector2f p, sf::Vector2f s, sf::Color fill, sf::Color outline, float thickness) {
+    position.push_back(p);
+    size.push_back(s);
+    fillColor.push_back(fill);
+    outlineColor.push_back(outline);
+    outlineThickness.push_back(thickness);
+}
+
+void RectangleStore::erase(std::size_t i) {
+    position.swapRemove(i);
+    size.swapRemove(i);
+    fillColor.swapRemove(i);
+    outlineColor.swapRemove(i);
+    outlineThickness.swapRemove(i);
+}
+
+sf::FloatRect RectangleStore::bounds(std::size_t i) const {
+    float t = outlineThickness[i];
+    return sf::FloatRect(position[i] - sf::Vector2f(t, t), size[i] + sf::Vector2f(2 * t, 2 * t));
+}
+
+void RectangleStore::clear() {
+    position.clear();
+    size.clear();
+    fillColor.clear();
+    outlineColor.clear();
+    outlineThickness.clear();
+}
+
+void RectangleStore::detach() {
+    position.detach();
+    size.detach();
+    fillColor.detach();
+    outlineColor.detach();
+    outlineThickness.detach();
+}
+
+std::size_t RectangleStore::bytesUsed() const {
+    return capacityBytes(position) + capacityBytes(size) + capacityBytes(fillColor) +
+        capacityBytes(outlineColor) + capacityBytes(outlineThickness);
+}
+
+void CircleStore::add(sf::Vector2f c, float r, sf::Color outline, float thickness) {
+    center.push_back(c);
+    radius.push_back(r);
+    outlineColor.push_back(outline);
+    outlineThickness.push_back(thickness);
+}
+
+void CircleStore::erase(std::size_t i) {
+    center.swapRemove(i);
+    radius.swapRemove(i);
+    outlineColor.swapRemove(i);
+    outlineThickness.swapRemove(i);
+}
+
+sf::FloatRect CircleStore::bounds(std::size_t i) const {
+    float r = radius[i] + outlineThickness[i];
+    return sf::FloatRect(center[i] - sf::Vector2f(r, r), sf::Vector2f(2 * r, 2 * r));
+}
+
+void CircleStore::clear() {
+    center.clear();
+    radius.clear();
+    outlineColor.clear();
+    outlineThickness.clear();
+}
+
+void CircleStore::detach() {
+    center.detach();
+    radius.detach();
+    outlineColor.detach();
+    outlineThickness.detach();
+}
+
+std::size_t CircleStore::bytesUsed() const {
+    return capacityBytes(center) + capacityBytes(radius) + capacityBytes(outlineColor) +
+        capacityBytes(outlineThickness);
+}
+
+std::size_t Document::count(ShapeKind kind) const {
+    switch (kind) {
+    case ShapeKind::Line:
+        return lines.size();
+    case ShapeKind::Rectangle:
+        return rectangles.count();
+    case ShapeKind::Circle:
+        return circles.count();
+    }
+    return 0;
+}
+
+sf::FloatRect Document::bounds(ShapeRef shape) const {
+    switch (shape.kind) {
+    case ShapeKind::Line:
+        return lineBounds(lines[shape.index]);
+    case ShapeKind::Rectangle:
+        return rectangles.bounds(shape.index);
+    case ShapeKind::Circle:
+        return circles.bounds(shape.index);
+    }
+    return {};
+}
+
+ShapeData Document::get(ShapeRef shape) const {
+    std::size_t i = shape.index;
+    switch (shape.kind) {
+    case ShapeKind::Line:
+        return lines[i];
+    case ShapeKind::Rectangle:
+        return RectangleData{ rectangles.position[i], rectangles.size[i], rectangles.fillColor[i],
+            rectangles.outlineColor[i], rectangles.outlineThickness[i] };
+    case ShapeKind::Circle:
+        return CircleData{ circles.center[i], circles.radius[i], circles.outlineColor[i], circles.outlineThickness[i] };
+    }
+    return {};
+}
+
+std::optional<ShapeRef> Document::find(ShapeHandle handle) const {
+    std::optional<std::uint32_t> index = slotsOf(handle.kind).find(handle.slot, handle.generation, count(handle.kind));
+    if (!index) return std::nullopt;
+    return ShapeRef{ handle.kind, *index };
+}
+
+ShapeHandle Document::handleOf(ShapeRef shape) const {
+    const SlotMap& kindSlots = slotsOf(shape.kind);
+    std::uint32_t slot = kindSlots.slotAt(shape.index);
+    return { shape.kind, slot, kindSlots.generationOf(slot) };
+}
+
+void Document::sortByDepth(std::vector<ShapeHandle>& shapes) const {
+    // Look every depth up once rather than twice per comparison.
+    std::vector<std::pair<std::uint64_t, std::size_t>> keyed(shapes.size());
+    for (std::size_t i = 0; i < shapes.size(); ++i) keyed[i] = { order.depthOf(*find(shapes[i])), i };
+    std::sort(keyed.begin(), keyed.end());
+
+    std::vector<ShapeHandle> sorted(shapes.size());
+    for (std::size_t i = 0; i < keyed.size(); ++i) sorted[i] = shapes[keyed[i].second];
+    shapes.swap(sorted);
+}
+
+std::optional<ShapeHandle> Document::below(ShapeHandle shape) {
+    std::optional<ShapeRef> neighbour = order.below(*find(shape));
+    if (!neighbour) return std::nullopt;
+    return handleOf(*neighbour);
+}
+
+std::optional<ShapeHandle> Document::top() {
+    std::optional<ShapeRef> shape = order.top();
+    if (!shape) return std::nullopt;
+    return handleOf(*shape);
+}
+
+ShapeHandle Document::add(const Line& line) {
+    return add(ShapeData(line));
+}
+
+ShapeHandle Document::add(const RectangleData& rectangle) {
+    return add(ShapeData(rectangle));
+}
+
+ShapeHandle Document::add(const CircleData& circle) {
+    return add(ShapeData(circle));
+}
+
+ShapeHandle Document::add(const ShapeData& shape) {
+    ShapeKind kind = shapeKind(shape);
+    append(*this, shape);
+    std::uint32_t slot = slots[static_cast<std::size_t>(kind)].insert(count(kind));
+    return { kind, slot, slotsOf(kind).generationOf(slot) };
+}
+
+void Document::restore(ShapeHandle handle, const ShapeData& shape) {
+    append(*this, shape);
+    slots[static_cast<std::size_t>(handle.kind)].insertAt(handle.slot, handle.generation, count(handle.kind));
+}
+
+void Document::erase(ShapeRef shape) {
+    order.erase(shape);
+    slots[static_cast<std::size_t>(shape.kind)].erase(shape.index, count(shape.kind));
+    switch (shape.kind) {
+    case ShapeKind::Line:
+        lines.swapRemove(shape.index);
+        break;
+    case ShapeKind::Rectangle:
+        rectangles.erase(shape.index);
+        break;
+    case ShapeKind::Circle:
+        circles.erase(shape.index);
+        break;
+    }
+}
+
+void Document::clear() {
+    lines.clear();
+    rectangles.clear();
+    circles.clear();
+    order.clear();
+    for (SlotMap& kindSlots : slots) kindSlots.clear();
+}
+
+void Document::detach() {
+    lines.detach();
+    rectangles.detach();
+    circles.detach();
+    order.detach();
+}
+
+std::vector<MemoryReportRow> memoryReport(const Document& document) {
+    std::vector<MemoryReportRow> rows;
+    rows.push_back({ "Lines", document.lines.size(), sizeof(Line), sizeof(Line),
+        capacityBytes(document.lines) });
+    rows.push_back({ "Rectangles", document.rectangles.count(),
+        sfmlShapeBytes(sizeof(sf::RectangleShape), 4),
+        sizeof(sf::Vector2f) * 2 + sizeof(sf::Color) * 2 + sizeof(float),
+        document.rectangles.bytesUsed() });
+    rows.push_back({ "Circles", document.circles.count(),
+        sfmlShapeBytes(sizeof(sf::CircleShape), 30),
+        sizeof(sf::Vector2f) + sizeof(float) + sizeof(sf::Color) + sizeof(float),
+        document.circles.bytesUsed() });
+    // A depth label, plus two links once the order has been edited.
+    rows.push_back({ "Draw order", document.shapeCount(), 0, sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t),
+        document.order.bytesUsed() });
+    // A slot number, plus the slot's index and generation, once shapes have
+    // been added or erased since loading.
+    std::size_t handleBytes = 0;
+    for (const SlotMap& kindSlots : document.slots) handleBytes += kindSlots.bytesUsed();
+    rows.push_back({ "Handles", document.shapeCount(), 0, 3 * sizeof(std::uint32_t), handleBytes });
+    return rows;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "display_list.h"
+#include "pod_array.h"
+#include "shapes.h"
+#include "slot_map.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Rectangles and circles are stored struct-of-arrays: each field lives in
+// its own packed array, so a shape costs exactly the bytes of its fields
+// and there is no per-shape heap allocation. Geometry is tessellated on
+// demand when the shapes are drawn (see ShapeRenderer). The arrays can also
+// be views into a memory-mapped document file (see document_io.h).
+struct RectangleStore {
+    PodArray<sf::Vector2f> position;
+    PodArray<sf::Vector2f> size;
+    PodArray<sf::Color> fillColor;
+    PodArray<sf::Color> outlineColor;
+    PodArray<float> outlineThickness;
+
+    std::size_t count() const { return position.size(); }
+    void add(sf::Vector2f position, sf::Vector2f size, sf::Color fill, sf::Color outline, float thickness);
+    // Moves the last rectangle into i's place.
+    void erase(std::size_t i);
+    sf::FloatRect bounds(std::size_t i) const;
+    void clear();
+    void detach();
+    std::size_t bytesUsed() const;
+};
+
+struct CircleStore {
+    PodArray<sf::Vector2f> center;
+    PodArray<float> radius;
+    PodArray<sf::Color> outlineColor;
+    PodArray<float> outlineThickness;
+
+    std::size_t count() const { return center.size(); }
+    void add(sf::Vector2f center, float radius, sf::Color outline, float thickness);
+    // Moves the last circle into i's place.
+    void erase(std::size_t i);
+    sf::FloatRect bounds(std::size_t i) const;
+    void clear();
+    void detach();
+    std::size_t bytesUsed() const;
+};
+
+// Shapes should be added and erased through Document rather than the
+// stores, so their place in the draw order and their handle follow along.
+// Erasing moves the last shape of the same kind into the erased one's
+// index, so indices (ShapeRef) are only good until the next erase; hold on
+// to shapes by handle instead.
+struct Document {
+    PodArray<Line> lines;
+    RectangleStore rectangles;
+    CircleStore circles;
+    DisplayList order;
+    // Handles of each kind's shapes, indexed by ShapeKind. Not saved: a
+    // loaded document starts over with handles matching the indices.
+    SlotMap slots[SHAPE_KIND_COUNT];
+
+    std::size_t shapeCount() const { return lines.size() + rectangles.count() + circles.count(); }
+    std::size_t count(ShapeKind kind) const;
+    sf::FloatRect bounds(ShapeRef shape) const;
+    ShapeData get(ShapeRef shape) const;
+    const SlotMap& slotsOf(ShapeKind kind) const { return slots[static_cast<std::size_t>(kind)]; }
+    std::optional<ShapeRef> find(ShapeHandle handle) const;
+    ShapeHandle handleOf(ShapeRef shape) const;
+    // Sorts `shapes`, which must all exist, bottom to top.
+    void sortByDepth(std::vector<ShapeHandle>& shapes) const;
+    // The shape directly below `shape` in the draw order, and the topmost
+    // one; see DisplayList.
+    std::optional<ShapeHandle> below(ShapeHandle shape);
+    std::optional<ShapeHandle> top();
+
+    // Each adds the shape on top of everything else.
+    ShapeHandle add(const Line& line);
+    ShapeHandle add(const RectangleData& rectangle);
+    ShapeHandle add(const CircleData& circle);
+    ShapeHandle add(const ShapeData& shape);
+    // Adds an erased shape back on top, under the handle it had before.
+    void restore(ShapeHandle handle, const ShapeData& shape);
+    void erase(ShapeRef shape);
+    void clear();
+    // Copies any arrays still viewing a mapped file into owned memory.
+    void detach();
+};
+
+struct MemoryReportRow {
+    const char* name;
+    std::size_t count;
+    std::size_t bytesPerShapeBefore;
+    std::size_t bytesPerShapeAfter;
+    std::size_t bytesUsed;
+};
+
+// Per-type comparison of the SFML shape objects the document used to hold
+// against the packed storage, including the heap the SFML shapes allocate
+// for their cached fill and outline vertices.
+std::vector<MemoryReportRow> memoryReport(const Document& document);
@@ -0,0 +1,271 @@
+#include "document_io.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+struct FileHeader {
+    char magic[4];
+    std::uint32_t version;
+};
+
+struct HeaderV2 {
+    FileHeader header;
+    std::uint32_t sectionCount;
+    std::uint32_t saveId;
+};
+
+enum SectionId : std::uint32_t {
+    SECTION_LINES = 1,
+    SECTION_RECTANGLE_POSITION,
+    SECTION_RECTANGLE_SIZE,
+    SECTION_RECTANGLE_FILL_COLOR,
+    SECTION_RECTANGLE_OUTLINE_COLOR,
+    SECTION_RECTANGLE_OUTLINE_THICKNESS,
+    SECTION_CIRCLE_CENTER,
+    SECTION_CIRCLE_RADIUS,
+    SECTION_CIRCLE_OUTLINE_COLOR,
+    SECTION_CIRCLE_OUTLINE_THICKNESS,
+    SECTION_LINE_DEPTH,
+    SECTION_RECTANGLE_DEPTH,
+    SECTION_CIRCLE_DEPTH
+};
+
+struct Section {
+    std::uint32_t id;
+    std::uint32_t elementSize;
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+static_assert(sizeof(HeaderV2) == 16 && sizeof(Section) == 24,
+    "header layout is part of the file format");
+
+struct FileCloser {
+    void operator()(std::FILE* file) const { std::fclose(file); }
+};
+using File = std::unique_ptr<std::FILE, FileCloser>;
+
+// Everything needed to write one array as a section.
+struct SectionSource {
+    SectionId id;
+    std::uint32_t elementSize;
+    const void* data;
+    std::uint64_t count;
+};
+
+template <typename T>
+SectionSource source(SectionId id, const PodArray<T>& values) {
+    return { id, sizeof(T), values.data(), values.size() };
+}
+
+// Sections are written in pieces this big so progress keeps moving.
+constexpr std::size_t WRITE_CHUNK_BYTES = 1 << 20;
+
+bool syncToDisk(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+std::uint64_t alignUp(std::uint64_t offset) {
+    return (offset + DOCUMENT_SECTION_ALIGNMENT - 1) / DOCUMENT_SECTION_ALIGNMENT * DOCUMENT_SECTION_ALIGNMENT;
+}
+
+bool writeDocument(std::FILE* file, const Document& document, std::uint32_t saveId, const SaveProgress& progress) {
+    const RectangleStore& r = document.rectangles;
+    const CircleStore& c = document.circles;
+    const DisplayList& order = document.order;
+    const SectionSource sources[] = {
+        source(SECTION_LINES, document.lines),
+        source(SECTION_RECTANGLE_POSITION, r.position),
+        source(SECTION_RECTANGLE_SIZE, r.size),
+        source(SECTION_RECTANGLE_FILL_COLOR, r.fillColor),
+        source(SECTION_RECTANGLE_OUTLINE_COLOR, r.outlineColor),
+        source(SECTION_RECTANGLE_OUTLINE_THICKNESS, r.outlineThickness),
+        source(SECTION_CIRCLE_CENTER, c.center),
+        source(SECTION_CIRCLE_RADIUS, c.radius),
+        source(SECTION_CIRCLE_OUTLINE_COLOR, c.outlineColor),
+        source(SECTION_CIRCLE_OUTLINE_THICKNESS, c.outlineThickness),
+        source(SECTION_LINE_DEPTH, order.depthsOf(ShapeKind::Line)),
+        source(SECTION_RECTANGLE_DEPTH, order.depthsOf(ShapeKind::Rectangle)),
+        source(SECTION_CIRCLE_DEPTH, order.depthsOf(ShapeKind::Circle)),
+    };
+    constexpr std::size_t sectionCount = sizeof(sources) / sizeof(sources[0]);
+
+    HeaderV2 header{};
+    std::memcpy(header.header.magic, DOCUMENT_MAGIC, sizeof(header.header.magic));
+    header.header.version = DOCUMENT_VERSION;
+    header.sectionCount = sectionCount;
+    header.saveId = saveId;
+
+    Section table[sectionCount];
+    std::uint64_t offset = alignUp(sizeof(header) + sizeof(table));
+    for (std::size_t i = 0; i < sectionCount; ++i) {
+        table[i] = { sources[i].id, sources[i].elementSize, offset, sources[i].count };
+        offset = alignUp(offset + sources[i].elementSize * sources[i].count);
+    }
+
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1 || std::fwrite(table, sizeof(table), 1, file) != 1) {
+        return false;
+    }
+
+    static const char padding[DOCUMENT_SECTION_ALIGNMENT] = {};
+    std::uint64_t written = sizeof(header) + sizeof(table);
+    for (std::size_t i = 0; i < sectionCount; ++i) {
+        std::size_t gap = static_cast<std::size_t>(table[i].offset - written);
+        if (gap && std::fwrite(padding, 1, gap, file) != gap) return false;
+        written += gap;
+
+        auto bytes = static_cast<const char*>(sources[i].data);
+        auto remaining = static_cast<std::size_t>(sources[i].elementSize * sources[i].count);
+        while (remaining > 0) {
+            std::size_t chunk = std::min(remaining, WRITE_CHUNK_BYTES);
+            if (std::fwrite(bytes, 1, chunk, file) != chunk) return false;
+            bytes += chunk;
+            remaining -= chunk;
+            written += chunk;
+            if (progress) progress(static_cast<float>(written) / static_cast<float>(offset));
+        }
+    }
+    return true;
+}
+
+// Points `values` at section `id` of the mapping, after checking it lies
+// inside the file and matches the element type.
+template <typename T>
+bool viewSection(const std::shared_ptr<MappedFile>& file, const Section* table, std::uint32_t sectionCount,
+    SectionId id, std::uint64_t expectedCount, PodArray<T>& values) {
+    for (std::uint32_t i = 0; i < sectionCount; ++i) {
+        const Section& section = table[i];
+        if (section.id != id) continue;
+
+        std::uint64_t bytes = section.count * sizeof(T);
+        if (section.elementSize != sizeof(T) || section.offset % alignof(T) != 0 || section.count != expectedCount ||
+            section.count > file->size() / sizeof(T) || section.offset > file->size() - bytes) {
+            return false;
+        }
+        values.view(file, reinterpret_cast<const T*>(file->data() + section.offset),
+            static_cast<std::size_t>(section.count));
+        return true;
+    }
+    return false;
+}
+
+std::uint64_t countOf(const Section* table, std::uint32_t count, SectionId id) {
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (table[i].id == id) return table[i].count;
+    }
+    return 0;
+}
+
+bool loadV2(const std::shared_ptr<MappedFile>& file, Document& document) {
+    if (file->size() < sizeof(HeaderV2)) return false;
+    HeaderV2 header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (header.sectionCount > (file->size() - sizeof(header)) / sizeof(Section)) return false;
+
+    // The table sits right after the 16-byte header, which keeps it aligned.
+    auto table = reinterpret_cast<const Section*>(file->data() + sizeof(header));
+    std::uint32_t n = header.sectionCount;
+    std::uint64_t lines = countOf(table, n, SECTION_LINES);
+    std::uint64_t rectangles = countOf(table, n, SECTION_RECTANGLE_POSITION);
+    std::uint64_t circles = countOf(table, n, SECTION_CIRCLE_CENTER);
+
+    RectangleStore& r = document.rectangles;
+    CircleStore& c = document.circles;
+    bool ok = viewSection(file, table, n, SECTION_LINES, lines, document.lines) &&
+        viewSection(file, table, n, SECTION_RECTANGLE_POSITION, rectangles, r.position) &&
+        viewSection(file, table, n, SECTION_RECTANGLE_SIZE, rectangles, r.size) &&
+        viewSection(file, table, n, SECTION_RECTANGLE_FILL_COLOR, rectangles, r.fillColor) &&
+        viewSection(file, table, n, SECTION_RECTANGLE_OUTLINE_COLOR, rectangles, r.outlineColor) &&
+        viewSection(file, table, n, SECTION_RECTANGLE_OUTLINE_THICKNESS, rectangles, r.outlineThickness) &&
+        viewSection(file, table, n, SECTION_CIRCLE_CENTER, circles, c.center) &&
+        viewSection(file, table, n, SECTION_CIRCLE_RADIUS, circles, c.radius) &&
+        viewSection(file, table, n, SECTION_CIRCLE_OUTLINE_COLOR, circles, c.outlineColor) &&
+        viewSection(file, table, n, SECTION_CIRCLE_OUTLINE_THICKNESS, circles, c.outlineThickness);
+    if (!ok) return false;
+
+    DisplayList& order = document.order;
+    return viewSection(file, table, n, SECTION_LINE_DEPTH, lines, order.depthsOf(ShapeKind::Line)) &&
+        viewSection(file, table, n, SECTION_RECTANGLE_DEPTH, rectangles, order.depthsOf(ShapeKind::Rectangle)) &&
+        viewSection(file, table, n, SECTION_CIRCLE_DEPTH, circles, order.depthsOf(ShapeKind::Circle));
+}
+}
+
+bool saveDocument(const Document& document, const std::string& path, std::uint32_t saveId, std::string& error,
+    const SaveProgress& progress) {
+    std::string temporary = path + ".tmp";
+    File file(std::fopen(temporary.c_str(), "wb"));
+    if (!file) {
+        error = "cannot open " + temporary + " for writing";
+        return false;
+    }
+
+    bool ok = writeDocument(file.get(), document, saveId, progress) && syncToDisk(file.get());
+    if (std::fclose(file.release()) != 0) ok = false;
+
+    std::error_code renameError;
+    if (ok) std::filesystem::rename(temporary, path, renameError);
+    if (!ok || renameError) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        error = "failed writing " + path;
+        return false;
+    }
+    return true;
+}
+
+bool loadDocument(const std::string& path, Document& document, std::string& error) {
+    document.clear();
+
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    FileHeader header{};
+    if (file->size() >= sizeof(header)) std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, DOCUMENT_MAGIC, sizeof(header.magic)) != 0) {
+        error = path + " is not a document file";
+        return false;
+    }
+
+    if (header.version != DOCUMENT_VERSION) {
+        error = path + " has unsupported version " + std::to_string(header.version);
+        return false;
+    }
+
+    bool ok = loadV2(file, document);
+    if (!ok) {
+        document.clear();
+        error = path + " is truncated or corrupt";
+    }
+    return ok;
+}
+
+bool readDocumentSaveId(const std::string& path, std::uint32_t& saveId) {
+    File file(std::fopen(path.c_str(), "rb"));
+    HeaderV2 header;
+    if (!file || std::fread(&header, sizeof(header), 1, file.get()) != 1 ||
+        std::memcmp(header.header.magic, DOCUMENT_MAGIC, sizeof(header.header.magic)) != 0 ||
+        header.header.version != DOCUMENT_VERSION) {
+        return false;
+    }
+    saveId = header.saveId;
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "document.h"
+
+#include <functional>
+#include <string>
+
+// Document files start with a small header and a section table; each shape
+// array follows as one raw section aligned to DOCUMENT_SECTION_ALIGNMENT,
+// so a loaded document can use the file's bytes in place (see PodArray).
+// Values are in host (little-endian) byte order. Files without the draw
+// order sections get the default order (see DisplayList).
+constexpr char DOCUMENT_MAGIC[4] = { 'P', 'N', 'T', 'D' };
+constexpr std::uint32_t DOCUMENT_VERSION = 2;
+constexpr std::size_t DOCUMENT_SECTION_ALIGNMENT = 64;
+
+// Fraction of the file written so far, from 0 to 1.
+using SaveProgress = std::function<void(float)>;
+
+// Both return false and describe the problem in `error` on failure; a failed
+// load leaves `document` empty. Saving writes a temporary file next to
+// `path`, flushes it to disk and renames it over, so neither an interrupted
+// save nor a crash right after one leaves a truncated document behind.
+// `saveId` is stored in the header to tell saves of the same path apart
+// (see Journal); 0 means none.
+bool saveDocument(const Document& document, const std::string& path, std::uint32_t saveId, std::string& error,
+    const SaveProgress& progress = {});
+// Maps the file and makes the document's arrays views into it; the mapping
+// lives until the last array referencing it is detached or cleared.
+bool loadDocument(const std::string& path, Document& document, std::string& error);
+// Reads just the save id from a document's header; false if the file is
+// missing or not a version 2 document.
+bool readDocumentSaveId(const std::string& path, std::uint32_t& saveId);
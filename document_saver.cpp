@@ -0,0 +1,83 @@
+#include "document_saver.h"
+#include "document_io.h"
+
+DocumentSaver::DocumentSaver()
+    : worker(&DocumentSaver::run, this) {
+}
+
+DocumentSaver::~DocumentSaver() {
+    // A queued save still runs, so quitting right after Save As keeps the file.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+std::uint64_t DocumentSaver::save(Document snapshot, const std::string& path, std::uint32_t saveId,
+    std::function<bool()> beforeWrite) {
+    std::uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ticket = nextTicket++;
+        pending = Job{ std::move(snapshot), path, saveId, std::move(beforeWrite), ticket };
+    }
+    wake.notify_one();
+    return ticket;
+}
+
+bool DocumentSaver::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return working || pending.has_value();
+}
+
+DocumentSaver::Status DocumentSaver::getStatus() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return status;
+}
+
+std::vector<DocumentSaver::Result> DocumentSaver::takeFinished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Result> taken;
+    taken.swap(results);
+    return taken;
+}
+
+void DocumentSaver::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return !working && !pending; });
+}
+
+void DocumentSaver::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopRequested || pending.has_value(); });
+        if (!pending) return;
+
+        Job job = std::move(*pending);
+        pending.reset();
+        working = true;
+        status = { State::Saving, job.path, {} };
+        progress = 0.0f;
+        lock.unlock();
+
+        std::string error;
+        bool ok = true;
+        if (job.beforeWrite && !job.beforeWrite()) {
+            ok = false;
+            error = "aborted before writing " + job.path;
+        }
+        if (ok) ok = saveDocument(job.snapshot, job.path, job.saveId, error, [this](float done) { progress = done; });
+        std::uint64_t ticket = job.ticket;
+        // Release the snapshot (and any mapping it holds) outside the lock.
+        job = Job{};
+
+        lock.lock();
+        working = false;
+        status = { ok ? State::Saved : State::Failed, status.path, error };
+        results.push_back({ ticket, ok });
+        finished.fetch_add(1, std::memory_order_release);
+        idle.notify_all();
+    }
+}
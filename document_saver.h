@@ -0,0 +1,84 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes documents on a worker thread so saving never blocks a frame. The
+// caller hands over a snapshot (a plain copy of the packed arrays, or just
+// a reference to the mapping for arrays still viewing the open file); the
+// worker serializes it, syncs it to disk and reports progress.
+class DocumentSaver {
+public:
+    enum class State {
+        Idle,
+        Saving,
+        Saved,
+        Failed
+    };
+
+    struct Status {
+        State state = State::Idle;
+        std::string path;
+        std::string error;
+    };
+
+    // How one save ended; see takeFinished().
+    struct Result {
+        std::uint64_t ticket;
+        bool ok;
+    };
+
+    DocumentSaver();
+    ~DocumentSaver();
+
+    // Queues `snapshot` for `path`, stamped with `saveId`. A queued save that
+    // has not started yet is replaced, since the newer snapshot supersedes it.
+    // `beforeWrite` runs on the worker first; it may block, and if it returns
+    // false the save fails without touching the file. Returns a ticket that
+    // identifies this save in takeFinished().
+    std::uint64_t save(Document snapshot, const std::string& path, std::uint32_t saveId = 0,
+        std::function<bool()> beforeWrite = {});
+    bool isBusy() const;
+    Status getStatus() const;
+    float getProgress() const { return progress.load(std::memory_order_relaxed); }
+    // Increases every time a save finishes, successfully or not.
+    std::uint64_t getFinishedCount() const { return finished.load(std::memory_order_acquire); }
+    // Saves that finished since the last call, oldest first. A save that was
+    // replaced before it started never shows up.
+    std::vector<Result> takeFinished();
+    // Blocks until every queued save has finished.
+    void waitUntilIdle();
+
+private:
+    struct Job {
+        Document snapshot;
+        std::string path;
+        std::uint32_t saveId;
+        std::function<bool()> beforeWrite;
+        std::uint64_t ticket;
+    };
+
+    void run();
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::optional<Job> pending;
+    bool working = false;
+    bool stopRequested = false;
+    Status status;
+    std::uint64_t nextTicket = 1;
+    std::vector<Result> results;
+    std::atomic<float> progress{ 0.0f };
+    std::atomic<std::uint64_t> finished{ 0 };
+    std::thread worker;
+};
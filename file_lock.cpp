@@ -0,0 +1,77 @@
+#include "file_lock.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileLock::~FileLock() {
+    unlock();
+}
+
+#ifdef _WIN32
+namespace {
+// Windows byte-range locks are mandatory, so the lock covers a byte far
+// beyond any real data instead of the file's contents.
+constexpr DWORD LOCK_OFFSET_HIGH = 0x40000000;
+}
+
+bool FileLock::tryLock(const std::string& lockPath) {
+    unlock();
+
+    // Read access only, so the file can still be mapped and rewritten.
+    HANDLE file = CreateFileA(lockPath.c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    OVERLAPPED range{};
+    range.OffsetHigh = LOCK_OFFSET_HIGH;
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &range)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    handle = file;
+    path = lockPath;
+    return true;
+}
+
+void FileLock::unlock() {
+    // Closing the handle releases the lock.
+    if (handle) CloseHandle(handle);
+    handle = nullptr;
+    path.clear();
+}
+#else
+bool FileLock::tryLock(const std::string& lockPath) {
+    unlock();
+
+    int file = ::open(lockPath.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (file < 0) return false;
+    // The previous owner may have deleted the file between our open() and
+    // flock(); a lock on the unlinked file would protect nothing.
+    struct stat opened;
+    struct stat current;
+    if (flock(file, LOCK_EX | LOCK_NB) != 0 || fstat(file, &opened) != 0 || stat(lockPath.c_str(), &current) != 0 ||
+        opened.st_dev != current.st_dev || opened.st_ino != current.st_ino) {
+        ::close(file);
+        return false;
+    }
+
+    fd = file;
+    path = lockPath;
+    return true;
+}
+
+void FileLock::unlock() {
+    // Closing the descriptor releases the lock.
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    path.clear();
+}
+#endif
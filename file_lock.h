@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+// Exclusive advisory lock on a file, released by the OS if the process
+// dies. It only keeps other tryLock() calls out; reading and writing the
+// file through other handles still works.
+class FileLock {
+public:
+    FileLock() = default;
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+    ~FileLock();
+
+    // Creates `path` if it does not exist. Fails if another process holds
+    // the lock or the file cannot be opened.
+    bool tryLock(const std::string& path);
+    void unlock();
+    bool isLocked() const { return !path.empty(); }
+    const std::string& getPath() const { return path; }
+
+private:
+    std::string path;
+#ifdef _WIN32
+    void* handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
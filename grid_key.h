@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// Hash map key for a cell of an unbounded 2D grid. The coordinates are
+// packed as unsigned bits, so cells left of or above the origin are fine.
+inline std::uint64_t gridKey(int x, int y) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
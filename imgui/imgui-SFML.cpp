@@ -10,13 +10,18 @@
 #include <SFML/Graphics/Texture.hpp>
 #include <SFML/OpenGL.hpp>
 #include <SFML/Window/Clipboard.hpp>
+#include <SFML/Window/Context.hpp>
 #include <SFML/Window/Cursor.hpp>
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Touch.hpp>
 #include <SFML/Window/Window.hpp>
 
+#include "../profiler.h"
+
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 
 #include <algorithm>
@@ -175,7 +180,8 @@ struct SpriteTextureData
             convertGLTextureHandleToImTextureID(texture.getNativeHandle())};
 }
 
-void RenderDrawLists(ImDrawData* draw_data); // rendering callback function prototype
+void RenderDrawLists(ImDrawData* draw_data, bool state_saved, bool to_layer); // rendering callback function prototype
+[[nodiscard]] bool renderFromLayer(sf::RenderTarget& target, ImDrawData* draw_data);
 
 // Default mapping is XInput gamepad mapping
 void initDefaultJoystickMapping();
@@ -264,6 +270,12 @@ struct WindowContext
 
     std::optional<sf::Cursor> mouseCursors[ImGuiMouseCursor_COUNT];
 
+    // The UI as last rendered into an offscreen layer, which is composited
+    // instead of re-rendering while the draw data stays the same.
+    std::optional<sf::RenderTexture> uiLayer;
+    std::optional<std::uint64_t>     uiLayerFingerprint;
+    std::optional<std::uint64_t>     lastFingerprint;
+
 #ifdef ANDROID
 #ifdef USE_JNI
     bool wantTextInput{false};
@@ -283,7 +295,9 @@ struct WindowContext
 };
 
 std::vector<std::unique_ptr<WindowContext>> s_windowContexts;
-WindowContext*                              s_currWindowCtx = nullptr;
+WindowContext*                              s_currWindowCtx   = nullptr;
+bool                                        s_glStateTracking = true;
+bool                                        s_layerCaching    = true;
 
 } // end of anonymous namespace
 
@@ -572,17 +586,40 @@ void Render(sf::RenderWindow& window)
 
 void Render(sf::RenderTarget& target)
 {
+    ImGui::Render();
+    ImDrawData* draw_data = ImGui::GetDrawData();
+    if (s_layerCaching && renderFromLayer(target, draw_data))
+        return;
+
     target.resetGLStates();
     target.pushGLStates();
-    ImGui::Render();
-    RenderDrawLists(ImGui::GetDrawData());
+    RenderDrawLists(draw_data, s_glStateTracking, false);
     target.popGLStates();
 }
 
 void Render()
 {
     ImGui::Render();
-    RenderDrawLists(ImGui::GetDrawData());
+    RenderDrawLists(ImGui::GetDrawData(), false, false);
+}
+
+void SetGLStateTracking(bool enabled)
+{
+    s_glStateTracking = enabled;
+}
+
+void SetLayerCaching(bool enabled)
+{
+    s_layerCaching = enabled;
+    if (!enabled)
+    {
+        for (const std::unique_ptr<WindowContext>& ctx : s_windowContexts)
+        {
+            ctx->uiLayer.reset();
+            ctx->uiLayerFingerprint.reset();
+            ctx->lastFingerprint.reset();
+        }
+    }
 }
 
 void Shutdown(const sf::Window& window)
@@ -891,15 +928,47 @@ void DrawRectFilled(const sf::FloatRect& rect, const sf::Color& color, float rou
 
 namespace
 {
+// Buffer objects (OpenGL 1.5) and glBlendFuncSeparate (OpenGL 1.4) are not
+// declared by <SFML/OpenGL.hpp>, which only promises OpenGL 1.1, so their
+// entry points are loaded through SFML.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+template <typename Function>
+void loadGLFunction(Function& function, const char* name, const char* fallbackName)
+{
+    function = reinterpret_cast<Function>(sf::Context::getFunction(name));
+    if (!function)
+        function = reinterpret_cast<Function>(sf::Context::getFunction(fallbackName));
+}
+
+// Loaded on first use of a UI layer, which cannot be drawn without it.
+using BlendFuncSeparateFn = void(APIENTRY*)(GLenum, GLenum, GLenum, GLenum);
+BlendFuncSeparateFn s_blendFuncSeparate{};
+bool                s_blendFuncSeparateLoaded{};
+
 // copied from imgui/backends/imgui_impl_opengl2.cpp
-void SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height)
+// With `to_layer`, colour is premultiplied and alpha keeps the coverage, so the
+// output can be composited over the target later (see renderFromLayer()).
+void SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height, bool to_layer)
 {
     // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor
     // enabled, vertex/texcoord/color pointers, polygon fill.
     glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    // glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); //
-    // In order to composite our output buffer we need to preserve alpha
+    if (to_layer)
+        s_blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    else
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_STENCIL_TEST);
@@ -921,7 +990,6 @@ void SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height)
     // viewport apps.
     glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
     glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
     glLoadIdentity();
 #ifdef GL_VERSION_ES_CL_1_1
     glOrthof(draw_data->DisplayPos.x,
@@ -939,13 +1007,102 @@ void SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height)
             +1.0f);
 #endif
     glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
     glLoadIdentity();
 }
 
-// Rendering callback
-void RenderDrawLists(ImDrawData* draw_data)
+// One vertex and one index buffer that every frame's draw data is streamed
+// into, so the driver gets the whole frame in two uploads instead of
+// copying from client memory on each glDrawElements. They live in SFML's
+// shared context and so are never deleted before exit.
+struct StreamBuffers
 {
+    using GenBuffersFn    = void(APIENTRY*)(GLsizei, GLuint*);
+    using BindBufferFn    = void(APIENTRY*)(GLenum, GLuint);
+    using BufferDataFn    = void(APIENTRY*)(GLenum, std::ptrdiff_t, const void*, GLenum);
+    using BufferSubDataFn = void(APIENTRY*)(GLenum, std::ptrdiff_t, std::ptrdiff_t, const void*);
+
+    GenBuffersFn    genBuffers{};
+    BindBufferFn    bindBuffer{};
+    BufferDataFn    bufferData{};
+    BufferSubDataFn bufferSubData{};
+
+    bool        loaded{};
+    GLuint      vertexBuffer{};
+    GLuint      indexBuffer{};
+    std::size_t vertexCapacity{}; // in bytes
+    std::size_t indexCapacity{};  // in bytes
+};
+
+StreamBuffers s_streamBuffers;
+
+void loadStreamBuffers(StreamBuffers& buffers)
+{
+    buffers.loaded = true;
+    loadGLFunction(buffers.genBuffers, "glGenBuffers", "glGenBuffersARB");
+    loadGLFunction(buffers.bindBuffer, "glBindBuffer", "glBindBufferARB");
+    loadGLFunction(buffers.bufferData, "glBufferData", "glBufferDataARB");
+    loadGLFunction(buffers.bufferSubData, "glBufferSubData", "glBufferSubDataARB");
+    if (!buffers.genBuffers || !buffers.bindBuffer || !buffers.bufferData || !buffers.bufferSubData)
+        return;
+
+    GLuint names[2] = {};
+    buffers.genBuffers(2, names);
+    buffers.vertexBuffer = names[0];
+    buffers.indexBuffer  = names[1];
+}
+
+// Respecifies `target`'s store, which orphans last frame's copy instead of
+// waiting for the draws still reading it, growing it to at least `bytes`.
+void orphanBuffer(const StreamBuffers& buffers, GLenum target, std::size_t& capacity, std::size_t bytes)
+{
+    if (bytes > capacity)
+        capacity = std::max(bytes, capacity * 2);
+    buffers.bufferData(target, static_cast<std::ptrdiff_t>(capacity), nullptr, GL_STREAM_DRAW);
+}
+
+// Uploads every command list's vertices and indices, one list after the
+// other, and leaves both buffers bound. Returns false when buffer objects
+// are unavailable and the lists must be drawn from client memory.
+bool streamDrawData(const ImDrawData* draw_data)
+{
+    StreamBuffers& buffers = s_streamBuffers;
+    if (!buffers.loaded)
+        loadStreamBuffers(buffers);
+    if (!buffers.vertexBuffer)
+        return false;
+
+    buffers.bindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+    buffers.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+    orphanBuffer(buffers, GL_ARRAY_BUFFER, buffers.vertexCapacity, draw_data->TotalVtxCount * sizeof(ImDrawVert));
+    orphanBuffer(buffers, GL_ELEMENT_ARRAY_BUFFER, buffers.indexCapacity, draw_data->TotalIdxCount * sizeof(ImDrawIdx));
+
+    std::size_t vtx_offset = 0;
+    std::size_t idx_offset = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list  = draw_data->CmdLists[n];
+        const std::size_t vtx_bytes = cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        const std::size_t idx_bytes = cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        buffers.bufferSubData(GL_ARRAY_BUFFER,
+                              static_cast<std::ptrdiff_t>(vtx_offset),
+                              static_cast<std::ptrdiff_t>(vtx_bytes),
+                              cmd_list->VtxBuffer.Data);
+        buffers.bufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                              static_cast<std::ptrdiff_t>(idx_offset),
+                              static_cast<std::ptrdiff_t>(idx_bytes),
+                              cmd_list->IdxBuffer.Data);
+        vtx_offset += vtx_bytes;
+        idx_offset += idx_bytes;
+    }
+    return true;
+}
+
+// Rendering callback. With `state_saved`, the caller has pushed the GL state
+// with sf::RenderTarget::pushGLStates() and pops it afterwards, so none of it
+// is queried or restored here. `to_layer` is for SetupRenderState().
+void RenderDrawLists(ImDrawData* draw_data, bool state_saved, bool to_layer)
+{
+    PROFILE_ZONE("RenderDrawLists");
     ImGui::GetDrawData();
     if (draw_data->CmdListsCount == 0)
     {
@@ -963,20 +1120,27 @@ void RenderDrawLists(ImDrawData* draw_data)
         return;
     draw_data->ScaleClipRects(io.DisplayFramebufferScale);
 
-    // Backup GL state
-    // Backup GL state
-    GLint last_texture = 0;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-    GLint last_polygon_mode[2];
-    glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
-    GLint last_viewport[4];
-    glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4];
-    glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLint last_shade_model = 0;
-    glGetIntegerv(GL_SHADE_MODEL, &last_shade_model);
-    GLint last_tex_env_mode = 0;
-    glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &last_tex_env_mode);
+#ifdef GL_VERSION_ES_CL_1_1
+    state_saved = false; // pushGLStates() only saves the matrices on OpenGL ES
+#endif
+
+    // Backup GL state. Each query stalls until the driver has caught up, so
+    // it is skipped when the caller saves the state anyway.
+    GLint last_texture         = 0;
+    GLint last_polygon_mode[2] = {};
+    GLint last_viewport[4]     = {};
+    GLint last_scissor_box[4]  = {};
+    GLint last_shade_model     = 0;
+    GLint last_tex_env_mode    = 0;
+    if (!state_saved)
+    {
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+        glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
+        glGetIntegerv(GL_VIEWPORT, last_viewport);
+        glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
+        glGetIntegerv(GL_SHADE_MODEL, &last_shade_model);
+        glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &last_tex_env_mode);
+    }
 
 #ifdef GL_VERSION_ES_CL_1_1
     GLint last_array_buffer;
@@ -984,29 +1148,53 @@ void RenderDrawLists(ImDrawData* draw_data)
     GLint last_element_array_buffer;
     glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
 #else
-    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT);
+    if (!state_saved)
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT);
 #endif
+    if (!state_saved)
+    {
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+    }
 
     // Setup desired GL state
-    SetupRenderState(draw_data, fb_width, fb_height);
+    SetupRenderState(draw_data, fb_width, fb_height, to_layer);
 
     // Will project scissor/clipping rectangles into framebuffer space
     const ImVec2 clip_off   = draw_data->DisplayPos;       // (0,0) unless using multi-viewports
     const ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display
                                                            // which are often (2,2)
 
+    // With the stream buffers bound, array and index pointers are byte
+    // offsets into them rather than addresses.
+    const bool  streamed   = streamDrawData(draw_data);
+    std::size_t vtx_offset = 0;
+    std::size_t idx_offset = 0;
+
+    // Commands mostly share the font texture, so it is only bound when it
+    // changes. The binding is unknown when the caller saved the state, and
+    // after user callbacks.
+    GLuint bound_texture = (GLuint)last_texture;
+    bool   texture_known = !state_saved;
+
     // Render command lists
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list   = draw_data->CmdLists[n];
-        const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
-        const ImDrawIdx*  idx_buffer = cmd_list->IdxBuffer.Data;
-        glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + offsetof(ImDrawVert, pos)));
-        glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + offsetof(ImDrawVert, uv)));
+        const char*       vtx_buffer = streamed ? reinterpret_cast<const char*>(static_cast<std::uintptr_t>(vtx_offset))
+                                                : reinterpret_cast<const char*>(cmd_list->VtxBuffer.Data);
+        const char*       idx_buffer = streamed ? reinterpret_cast<const char*>(static_cast<std::uintptr_t>(idx_offset))
+                                                : reinterpret_cast<const char*>(cmd_list->IdxBuffer.Data);
+        vtx_offset += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        idx_offset += cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)(vtx_buffer + offsetof(ImDrawVert, pos)));
+        glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)(vtx_buffer + offsetof(ImDrawVert, uv)));
         glColorPointer(4,
                        GL_UNSIGNED_BYTE,
                        sizeof(ImDrawVert),
-                       (const GLvoid*)((const char*)vtx_buffer + offsetof(ImDrawVert, col)));
+                       (const GLvoid*)(vtx_buffer + offsetof(ImDrawVert, col)));
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -1017,9 +1205,12 @@ void RenderDrawLists(ImDrawData* draw_data)
                 // (ImDrawCallback_ResetRenderState is a special callback value used by the user to
                 // request the renderer to reset render state.)
                 if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
-                    SetupRenderState(draw_data, fb_width, fb_height);
+                    SetupRenderState(draw_data, fb_width, fb_height, to_layer);
                 else
+                {
                     pcmd->UserCallback(cmd_list, pcmd);
+                    texture_known = false;
+                }
             }
             else
             {
@@ -1041,32 +1232,47 @@ void RenderDrawLists(ImDrawData* draw_data)
 
                     // Bind texture, Draw
                     const GLuint textureHandle = convertImTextureIDToGLTextureHandle(pcmd->GetTexID());
-                    glBindTexture(GL_TEXTURE_2D, textureHandle);
+                    if (!texture_known || textureHandle != bound_texture)
+                    {
+                        glBindTexture(GL_TEXTURE_2D, textureHandle);
+                        bound_texture = textureHandle;
+                        texture_known = true;
+                    }
                     glDrawElements(GL_TRIANGLES,
                                    (GLsizei)pcmd->ElemCount,
                                    sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
-                                   idx_buffer + pcmd->IdxOffset);
+                                   (const GLvoid*)(idx_buffer + pcmd->IdxOffset * sizeof(ImDrawIdx)));
+                    Profiler::instance().countDraw(pcmd->ElemCount);
                 }
             }
         }
     }
 
     // Restore modified GL state
-    glDisableClientState(GL_COLOR_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glBindTexture(GL_TEXTURE_2D, (GLuint)last_texture);
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glPopAttrib();
-    glPolygonMode(GL_FRONT, (GLenum)last_polygon_mode[0]);
-    glPolygonMode(GL_BACK, (GLenum)last_polygon_mode[1]);
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
-    glShadeModel((GLenum)last_shade_model);
-    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, last_tex_env_mode);
+    if (streamed)
+    {
+        // SFML draws vertex arrays from client memory, which needs no buffer bound
+        s_streamBuffers.bindBuffer(GL_ARRAY_BUFFER, 0);
+        s_streamBuffers.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    if (!state_saved)
+    {
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindTexture(GL_TEXTURE_2D, (GLuint)last_texture);
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glPopAttrib();
+        glPolygonMode(GL_FRONT, (GLenum)last_polygon_mode[0]);
+        glPolygonMode(GL_BACK, (GLenum)last_polygon_mode[1]);
+        glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
+        glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+        glShadeModel((GLenum)last_shade_model);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, last_tex_env_mode);
+    }
 
 #ifdef GL_VERSION_ES_CL_1_1
     glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
@@ -1075,6 +1281,133 @@ void RenderDrawLists(ImDrawData* draw_data)
 #endif
 }
 
+// Mixes `size` bytes into `hash` a word at a time; much faster than a
+// bytewise hash over the few hundred KiB of a typical frame.
+[[nodiscard]] std::uint64_t hashBytes(std::uint64_t hash, const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::size_t          i     = 0;
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+template <typename T>
+[[nodiscard]] std::uint64_t hashValue(std::uint64_t hash, const T& value)
+{
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+// Hashes everything RenderDrawLists() draws from: the display rectangle and
+// every list's vertices, indices and commands. Texture contents are not part
+// of it, only which textures are used. Returns false for frames with user
+// callbacks, which may draw something different each time.
+[[nodiscard]] bool fingerprintDrawData(const ImDrawData* draw_data, std::uint64_t& fingerprint)
+{
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+
+    hash = hashValue(hash, draw_data->DisplayPos);
+    hash = hashValue(hash, draw_data->DisplaySize);
+    hash = hashValue(hash, draw_data->FramebufferScale);
+    hash = hashValue(hash, draw_data->CmdListsCount);
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        hash = hashValue(hash, cmd_list->VtxBuffer.Size);
+        hash = hashBytes(hash, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+        hash = hashValue(hash, cmd_list->IdxBuffer.Size);
+        hash = hashBytes(hash, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+        hash = hashValue(hash, cmd_list->CmdBuffer.Size);
+        for (const ImDrawCmd& cmd : cmd_list->CmdBuffer)
+        {
+            if (cmd.UserCallback && cmd.UserCallback != ImDrawCallback_ResetRenderState)
+                return false;
+            hash = hashValue(hash, cmd.UserCallback != nullptr);
+            hash = hashValue(hash, cmd.ClipRect);
+            hash = hashValue(hash, cmd.GetTexID());
+            hash = hashValue(hash, cmd.VtxOffset);
+            hash = hashValue(hash, cmd.IdxOffset);
+            hash = hashValue(hash, cmd.ElemCount);
+        }
+    }
+    fingerprint = hash;
+    return true;
+}
+
+// Draws the UI by compositing the current window's layer, which keeps the
+// frame rendered last. The layer is only (re-)rendered once the same draw
+// data comes twice in a row, so a UI that changes every frame never pays
+// for the extra pass. Returns false, having drawn nothing, when the frame
+// should be rendered directly instead.
+bool renderFromLayer(sf::RenderTarget& target, ImDrawData* draw_data)
+{
+    if (!s_currWindowCtx)
+        return false;
+    WindowContext& ctx = *s_currWindowCtx;
+
+    if (!s_blendFuncSeparateLoaded)
+    {
+        if (!target.setActive(true))
+            return false;
+        s_blendFuncSeparateLoaded = true;
+        loadGLFunction(s_blendFuncSeparate, "glBlendFuncSeparate", "glBlendFuncSeparateEXT");
+    }
+
+    // The layer is drawn 1:1 over the whole target.
+    const sf::Vector2u size = target.getSize();
+    const sf::Vector2u fb_size((unsigned int)(draw_data->DisplaySize.x * draw_data->FramebufferScale.x),
+                               (unsigned int)(draw_data->DisplaySize.y * draw_data->FramebufferScale.y));
+    std::uint64_t      fingerprint = 0;
+    if (!s_blendFuncSeparate || fb_size != size || size.x == 0 || size.y == 0 ||
+        !fingerprintDrawData(draw_data, fingerprint))
+    {
+        ctx.uiLayerFingerprint.reset();
+        ctx.lastFingerprint.reset();
+        return false;
+    }
+
+    const bool repeated = ctx.lastFingerprint == fingerprint;
+    ctx.lastFingerprint = fingerprint;
+    if (ctx.uiLayerFingerprint != fingerprint)
+    {
+        if (!repeated)
+            return false;
+
+        if (!ctx.uiLayer || ctx.uiLayer->getSize() != size)
+        {
+            ctx.uiLayer.emplace();
+            if (!ctx.uiLayer->resize(size))
+            {
+                ctx.uiLayer.reset();
+                return false;
+            }
+        }
+        sf::RenderTexture& layer = *ctx.uiLayer;
+        layer.clear(sf::Color::Transparent);
+        layer.resetGLStates();
+        layer.pushGLStates();
+        RenderDrawLists(draw_data, s_glStateTracking, true);
+        layer.popGLStates();
+        layer.display();
+        ctx.uiLayerFingerprint = fingerprint;
+    }
+
+    // The layer holds premultiplied colour.
+    const sf::View view = target.getView();
+    target.setView(target.getDefaultView());
+    target.draw(sf::Sprite(ctx.uiLayer->getTexture()),
+                sf::RenderStates(sf::BlendMode(sf::BlendMode::Factor::One, sf::BlendMode::Factor::OneMinusSrcAlpha)));
+    target.setView(view);
+    return true;
+}
+
 void initDefaultJoystickMapping()
 {
     ImGui::SFML::SetJoystickMapping(ImGuiKey_GamepadFaceDown, 0);
@@ -40,6 +40,16 @@ IMGUI_SFML_API void Update(const sf::Vector2i& mousePos, const sf::Vector2f& dis
 IMGUI_SFML_API void Render(sf::RenderWindow& window);
 IMGUI_SFML_API void Render(sf::RenderTarget& target);
 IMGUI_SFML_API void Render();
+// Lets Render(target) rely on the GL state that the target's pushGLStates()
+// saves instead of querying and restoring it again. On by default; turn it
+// off if something else changes the GL state between those calls.
+IMGUI_SFML_API void SetGLStateTracking(bool enabled);
+// Lets Render(target) keep the UI in an offscreen layer the size of the
+// target and composite it, without re-rendering, while ImGui's draw data
+// stays the same. On by default. The draw data only names textures, so
+// turn it off if the UI shows a texture whose pixels change (e.g. an
+// sf::RenderTexture) while nothing else in the UI does.
+IMGUI_SFML_API void SetLayerCaching(bool enabled);
 
 IMGUI_SFML_API void Shutdown(const sf::Window& window);
 // Shuts down all ImGui contexts
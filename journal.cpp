@@ -0,0 +1,498 @@
+#include "journal.h"
+#include "document_io.h"
+#include "mapped_file.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char JOURNAL_MAGIC[4] = { 'P', 'N', 'T', 'J' };
+constexpr std::uint32_t JOURNAL_VERSION = 1;
+constexpr std::uint32_t BATCH_MAGIC = 0x48435442; // "BTCH"
+// Session journals are named paint-<pid>-<time>.journal.
+constexpr const char* JOURNAL_PREFIX = "paint";
+constexpr const char* JOURNAL_EXTENSION = ".journal";
+
+struct JournalHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t baseId;
+    std::uint32_t basePathLength;
+};
+
+struct BatchHeader {
+    std::uint32_t magic;
+    std::uint32_t size;
+    std::uint32_t checksum;
+};
+
+enum RecordType : std::uint8_t {
+    RECORD_LINE = 1,
+    RECORD_RECTANGLE,
+    RECORD_CIRCLE,
+    RECORD_SAVE,
+    RECORD_MOVE,
+    RECORD_ERASE
+};
+
+constexpr std::size_t LINE_BYTES = sizeof(Line);
+constexpr std::size_t RECTANGLE_BYTES = sizeof(sf::Vector2f) * 2 + sizeof(sf::Color) * 2 + sizeof(float);
+constexpr std::size_t CIRCLE_BYTES = sizeof(sf::Vector2f) + sizeof(float) + sizeof(sf::Color) + sizeof(float);
+constexpr std::size_t SHAPE_BYTES = sizeof(ShapeKind) + sizeof(std::uint32_t);
+// The moved shape, whether it has a shape below it, and that shape.
+constexpr std::size_t MOVE_BYTES = SHAPE_BYTES + sizeof(std::uint8_t) + SHAPE_BYTES;
+
+// FNV-1a; enough to tell a torn write from a complete one.
+std::uint32_t checksum(const std::uint8_t* bytes, std::size_t size) {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+bool syncToDisk(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+template <typename T>
+T take(const std::uint8_t*& cursor) {
+    T value;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+// A logged save: where its records end and the file it refers to.
+struct SavePoint {
+    std::size_t batch;
+    std::size_t offset;
+    std::string path;
+    std::uint32_t id;
+};
+
+// Size of the record at `cursor`, or 0 if it is malformed.
+std::size_t recordSize(const std::uint8_t* cursor, const std::uint8_t* end) {
+    switch (*cursor) {
+    case RECORD_LINE:
+        return 1 + LINE_BYTES;
+    case RECORD_RECTANGLE:
+        return 1 + RECTANGLE_BYTES;
+    case RECORD_CIRCLE:
+        return 1 + CIRCLE_BYTES;
+    case RECORD_MOVE:
+        return 1 + MOVE_BYTES;
+    case RECORD_ERASE:
+        return 1 + SHAPE_BYTES;
+    case RECORD_SAVE: {
+        if (end - cursor < 9) return 0;
+        std::uint32_t length;
+        std::memcpy(&length, cursor + 5, sizeof(length));
+        return 9 + static_cast<std::size_t>(length);
+    }
+    default:
+        return 0;
+    }
+}
+
+ShapeRef takeShape(const std::uint8_t*& cursor) {
+    auto kind = take<ShapeKind>(cursor);
+    return { kind, take<std::uint32_t>(cursor) };
+}
+
+bool exists(const Document& document, ShapeRef shape) {
+    return shape.kind <= ShapeKind::Circle && shape.index < document.count(shape.kind);
+}
+
+void applyRecord(const std::uint8_t* cursor, Document& document) {
+    RecordType type = static_cast<RecordType>(*cursor++);
+    if (type == RECORD_LINE) {
+        document.add(take<Line>(cursor));
+    }
+    else if (type == RECORD_RECTANGLE) {
+        RectangleData rectangle;
+        rectangle.position = take<sf::Vector2f>(cursor);
+        rectangle.size = take<sf::Vector2f>(cursor);
+        rectangle.fillColor = take<sf::Color>(cursor);
+        rectangle.outlineColor = take<sf::Color>(cursor);
+        rectangle.outlineThickness = take<float>(cursor);
+        document.add(rectangle);
+    }
+    else if (type == RECORD_CIRCLE) {
+        CircleData circle;
+        circle.center = take<sf::Vector2f>(cursor);
+        circle.radius = take<float>(cursor);
+        circle.outlineColor = take<sf::Color>(cursor);
+        circle.outlineThickness = take<float>(cursor);
+        document.add(circle);
+    }
+    else if (type == RECORD_ERASE) {
+        ShapeRef shape = takeShape(cursor);
+        if (exists(document, shape)) document.erase(shape);
+    }
+    else if (type == RECORD_MOVE) {
+        ShapeRef shape = takeShape(cursor);
+        bool hasBelow = take<std::uint8_t>(cursor) != 0;
+        ShapeRef below = takeShape(cursor);
+        if (!exists(document, shape) || (hasBelow && !exists(document, below))) return;
+        document.order.place(shape, hasBelow ? std::optional<ShapeRef>(below) : std::nullopt);
+    }
+}
+}
+
+Journal::~Journal() {
+    stop();
+}
+
+bool Journal::claim(const std::string& journalPath) {
+    stop();
+    return fileLock.tryLock(journalPath);
+}
+
+bool Journal::start(const std::string& journalPath, const std::string& basePath, std::uint32_t baseId) {
+    stop();
+    if (fileLock.getPath() != journalPath && !claim(journalPath)) return false;
+
+    file = std::fopen(journalPath.c_str(), "wb");
+    if (!file) return false;
+
+    JournalHeader header{};
+    std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.baseId = baseId;
+    header.basePathLength = static_cast<std::uint32_t>(basePath.size());
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+        std::fwrite(basePath.data(), 1, basePath.size(), file) != basePath.size() || !syncToDisk(file)) {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    launch();
+    return true;
+}
+
+bool Journal::resume(const std::string& journalPath, std::uint64_t validBytes) {
+    stop();
+    if (fileLock.getPath() != journalPath && !claim(journalPath)) return false;
+
+    std::error_code error;
+    std::filesystem::resize_file(journalPath, validBytes, error);
+    if (error) return false;
+    file = std::fopen(journalPath.c_str(), "ab");
+    if (!file) return false;
+
+    launch();
+    return true;
+}
+
+void Journal::stop() {
+    if (!worker.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    worker.join();
+    std::fclose(file);
+    file = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (failed) {
+        lostBytes = appendedBytes;
+    }
+    else {
+        durableBytes = appendedBytes;
+    }
+    synced.notify_all();
+}
+
+void Journal::discard() {
+    stop();
+    // Removed while still locked, so no other session can claim it in between.
+    if (fileLock.isLocked()) {
+        std::error_code ignored;
+        std::filesystem::remove(fileLock.getPath(), ignored);
+    }
+    fileLock.unlock();
+}
+
+void Journal::release() {
+    stop();
+    fileLock.unlock();
+}
+
+void Journal::launch() {
+    pending.clear();
+    stopRequested = false;
+    failed = false;
+    worker = std::thread(&Journal::run, this);
+}
+
+template <typename T>
+void Journal::put(const T& value) {
+    auto bytes = reinterpret_cast<const std::uint8_t*>(&value);
+    pending.insert(pending.end(), bytes, bytes + sizeof(T));
+    appendedBytes += sizeof(T);
+}
+
+void Journal::appendLine(const Line& line) {
+    if (!isOpen()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    put(RECORD_LINE);
+    put(line);
+    if (pending.size() >= FLUSH_BYTES) wake.notify_one();
+}
+
+void Journal::appendRectangle(const RectangleStore& rectangles, std::size_t i) {
+    if (!isOpen()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    put(RECORD_RECTANGLE);
+    put(rectangles.position[i]);
+    put(rectangles.size[i]);
+    put(rectangles.fillColor[i]);
+    put(rectangles.outlineColor[i]);
+    put(rectangles.outlineThickness[i]);
+    if (pending.size() >= FLUSH_BYTES) wake.notify_one();
+}
+
+void Journal::appendCircle(const CircleStore& circles, std::size_t i) {
+    if (!isOpen()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    put(RECORD_CIRCLE);
+    put(circles.center[i]);
+    put(circles.radius[i]);
+    put(circles.outlineColor[i]);
+    put(circles.outlineThickness[i]);
+    if (pending.size() >= FLUSH_BYTES) wake.notify_one();
+}
+
+void Journal::appendErase(ShapeRef shape) {
+    if (!isOpen()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    put(RECORD_ERASE);
+    put(shape.kind);
+    put(shape.index);
+    if (pending.size() >= FLUSH_BYTES) wake.notify_one();
+}
+
+void Journal::appendMove(ShapeRef shape, std::optional<ShapeRef> below) {
+    if (!isOpen()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    ShapeRef target = below.value_or(ShapeRef{ ShapeKind::Line, 0 });
+    put(RECORD_MOVE);
+    put(shape.kind);
+    put(shape.index);
+    put(static_cast<std::uint8_t>(below.has_value()));
+    put(target.kind);
+    put(target.index);
+    if (pending.size() >= FLUSH_BYTES) wake.notify_one();
+}
+
+std::uint64_t Journal::appendSave(const std::string& savePath, std::uint32_t saveId) {
+    if (!isOpen()) return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    put(RECORD_SAVE);
+    put(saveId);
+    put(static_cast<std::uint32_t>(savePath.size()));
+    pending.insert(pending.end(), savePath.begin(), savePath.end());
+    appendedBytes += savePath.size();
+    wake.notify_one();
+    return appendedBytes;
+}
+
+bool Journal::waitUntilDurable(std::uint64_t ticket) {
+    // Ticket 0 comes from a journal that was not open; there is nothing to wait for.
+    if (ticket == 0) return true;
+    std::unique_lock<std::mutex> lock(mutex);
+    synced.wait(lock, [&]() { return durableBytes >= ticket || lostBytes >= ticket; });
+    return lostBytes < ticket;
+}
+
+bool Journal::hasFailed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void Journal::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS),
+            [this]() { return stopRequested || pending.size() >= FLUSH_BYTES; });
+        bool stopping = stopRequested;
+        std::uint64_t flushing = appendedBytes;
+        writing.swap(pending);
+        lock.unlock();
+
+        bool ok = true;
+        if (!writing.empty() && !failed) {
+            BatchHeader batch{ BATCH_MAGIC, static_cast<std::uint32_t>(writing.size()),
+                checksum(writing.data(), writing.size()) };
+            ok = std::fwrite(&batch, sizeof(batch), 1, file) == 1 &&
+                std::fwrite(writing.data(), 1, writing.size(), file) == writing.size() && syncToDisk(file);
+        }
+        writing.clear();
+
+        lock.lock();
+        if (!ok) failed = true;
+        if (failed) {
+            lostBytes = flushing;
+        }
+        else {
+            durableBytes = flushing;
+        }
+        synced.notify_all();
+        if (stopping && pending.empty()) return;
+    }
+}
+
+bool replayJournal(const std::string& path, JournalReplay& replay, std::string& error) {
+    replay = JournalReplay{};
+
+    MappedFile file;
+    JournalHeader header;
+    if (!file.open(path) || file.size() < sizeof(header)) {
+        error = "cannot read journal " + path;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 || header.version != JOURNAL_VERSION ||
+        header.basePathLength > file.size() - sizeof(header)) {
+        error = path + " is not a journal";
+        return false;
+    }
+
+    const std::uint8_t* begin = file.data();
+    const std::uint8_t* end = begin + file.size();
+    const std::uint8_t* cursor = begin + sizeof(header);
+    std::string basePath(reinterpret_cast<const char*>(cursor), header.basePathLength);
+    cursor += header.basePathLength;
+
+    // First pass: find the intact batches and every logged save. A batch
+    // that is cut short or fails its checksum ends the journal.
+    struct Batch {
+        const std::uint8_t* begin;
+        const std::uint8_t* end;
+    };
+    std::vector<Batch> batches;
+    std::vector<SavePoint> saves{ { 0, 0, basePath, header.baseId } };
+    while (static_cast<std::size_t>(end - cursor) >= sizeof(BatchHeader)) {
+        BatchHeader batch = take<BatchHeader>(cursor);
+        if (batch.magic != BATCH_MAGIC || batch.size > static_cast<std::size_t>(end - cursor) ||
+            checksum(cursor, batch.size) != batch.checksum) {
+            cursor -= sizeof(BatchHeader);
+            break;
+        }
+
+        const std::uint8_t* record = cursor;
+        const std::uint8_t* batchEnd = cursor + batch.size;
+        while (record < batchEnd) {
+            std::size_t size = recordSize(record, batchEnd);
+            if (size == 0 || size > static_cast<std::size_t>(batchEnd - record)) {
+                error = path + " contains an unknown record";
+                return false;
+            }
+            if (*record == RECORD_SAVE) {
+                std::uint32_t id;
+                std::memcpy(&id, record + 1, sizeof(id));
+                std::string savePath(reinterpret_cast<const char*>(record + 9), size - 9);
+                saves.push_back({ batches.size(), static_cast<std::size_t>(record + size - cursor), savePath, id });
+            }
+            record += size;
+        }
+        batches.push_back({ cursor, batchEnd });
+        cursor = batchEnd;
+    }
+    replay.validBytes = static_cast<std::uint64_t>(cursor - begin);
+
+    // Newest save that actually reached the disk; the session's base
+    // document counts as the oldest one.
+    const SavePoint* from = nullptr;
+    for (auto save = saves.rbegin(); save != saves.rend() && !from; ++save) {
+        if (save->path.empty()) {
+            from = &*save;
+            break;
+        }
+        // The session's base may predate save ids, in which case it has 0.
+        std::uint32_t id = 0;
+        bool matches = save->id == 0 || (readDocumentSaveId(save->path, id) && id == save->id);
+        if (matches && loadDocument(save->path, replay.document, error)) {
+            from = &*save;
+        }
+    }
+    if (from) {
+        replay.basePath = from->path;
+        error.clear();
+    }
+    else {
+        error = "none of the documents this journal builds on could be loaded; recovered shapes only";
+        from = &saves.front();
+    }
+
+    // Second pass: apply everything after the chosen save.
+    for (std::size_t b = from->batch; b < batches.size(); ++b) {
+        const std::uint8_t* record = batches[b].begin + (b == from->batch ? from->offset : 0);
+        while (record < batches[b].end) {
+            std::size_t size = recordSize(record, batches[b].end);
+            if (*record != RECORD_SAVE) {
+                applyRecord(record, replay.document);
+                ++replay.appliedRecords;
+            }
+            record += size;
+        }
+    }
+    return true;
+}
+
+std::string sessionJournalPath() {
+#ifdef _WIN32
+    long long pid = _getpid();
+#else
+    long long pid = getpid();
+#endif
+    long long started = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::string(JOURNAL_PREFIX) + "-" + std::to_string(pid) + "-" + std::to_string(started) + JOURNAL_EXTENSION;
+}
+
+std::vector<std::string> findJournals() {
+    std::vector<std::pair<std::filesystem::file_time_type, std::string>> found;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(".", error), end; !error && it != end; it.increment(error)) {
+        std::error_code ignored;
+        std::string name = it->path().filename().string();
+        if (!it->is_regular_file(ignored) || name.rfind(JOURNAL_PREFIX, 0) != 0 ||
+            it->path().extension() != JOURNAL_EXTENSION) {
+            continue;
+        }
+        found.emplace_back(it->last_write_time(ignored), name);
+    }
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<std::string> paths;
+    for (auto& entry : found) paths.push_back(std::move(entry.second));
+    return paths;
+}
+
+std::uint32_t newSaveId() {
+    static std::mt19937 random(std::random_device{}());
+    std::uint32_t id;
+    do {
+        id = static_cast<std::uint32_t>(random());
+    } while (id == 0);
+    return id;
+}
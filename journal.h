@@ -0,0 +1,118 @@
+#pragma once
+
+#include "document.h"
+#include "file_lock.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Append-only log of every edit to the document (shapes committed, erased
+// or moved in the draw order), so work survives a crash. Shapes are
+// recorded by index, which replay reproduces exactly. The file starts with
+// the document the session began from (a path and its save id, or nothing
+// for a new document), followed by checksummed batches of records.
+// Records are buffered in memory and a writer thread flushes them as one
+// batch and one fsync per interval, so committing a shape never waits for
+// the disk.
+//
+// Saves are logged too, before they start, with the id stamped into the
+// saved file. Replay starts from the newest logged save whose file carries
+// that id and applies only the records after it, which stays correct if
+// the crash hit in the middle of a save.
+//
+// Every session writes its own journal and holds a lock on it until the
+// journal is discarded, so a journal nobody holds was left by a crash.
+class Journal {
+public:
+    static constexpr int FLUSH_INTERVAL_MS = 100;
+    // Pending records beyond this size are flushed without waiting.
+    static constexpr std::size_t FLUSH_BYTES = 1 << 18;
+
+    ~Journal();
+
+    // Locks `path`; fails while the session that wrote it is still running.
+    // start() and resume() claim their path if it is not held already.
+    bool claim(const std::string& path);
+    // Starts a new journal at `path` for a session based on `basePath`
+    // (empty for a new document).
+    bool start(const std::string& path, const std::string& basePath, std::uint32_t baseId);
+    // Keeps appending to a replayed journal, dropping its torn tail.
+    bool resume(const std::string& path, std::uint64_t validBytes);
+    // Flushes and closes the file. discard() also deletes it and releases
+    // the lock, which is what marks a shutdown as clean; release() gives up
+    // the lock but leaves the file for a later session.
+    void stop();
+    void discard();
+    void release();
+    bool isOpen() const { return worker.joinable(); }
+
+    void appendLine(const Line& line);
+    void appendRectangle(const RectangleStore& rectangles, std::size_t i);
+    void appendCircle(const CircleStore& circles, std::size_t i);
+    // Logged before the document erases `shape`; see Document::erase().
+    void appendErase(ShapeRef shape);
+    // A shape moved in the draw order; see DisplayList::place().
+    void appendMove(ShapeRef shape, std::optional<ShapeRef> below);
+    // Returns a ticket for waitUntilDurable(); the save must not replace
+    // any file before its marker is on disk.
+    std::uint64_t appendSave(const std::string& path, std::uint32_t saveId);
+    // Blocks until everything appended up to `ticket` has been synced.
+    // Returns false if writing the journal failed first; those records are
+    // not on disk. Meant for worker threads, not the frame loop.
+    bool waitUntilDurable(std::uint64_t ticket);
+    // Whether a write or sync failed; the journal stops writing after one,
+    // since replay ends at the first torn batch anyway.
+    bool hasFailed() const;
+
+private:
+    void launch();
+    void run();
+    template <typename T>
+    void put(const T& value);
+
+    FileLock fileLock;
+    std::FILE* file = nullptr;
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable synced;
+    std::vector<std::uint8_t> pending;
+    // Running totals over the journal's whole lifetime, so tickets stay
+    // valid across start() and stop().
+    std::uint64_t appendedBytes = 0;
+    std::uint64_t durableBytes = 0;
+    // Everything appended up to here may be missing from the disk.
+    std::uint64_t lostBytes = 0;
+    bool failed = false;
+    std::vector<std::uint8_t> writing;
+    bool stopRequested = false;
+};
+
+struct JournalReplay {
+    Document document;
+    // The saved file replay started from, or empty.
+    std::string basePath;
+    std::uint64_t appliedRecords = 0;
+    // Length of the intact part of the journal.
+    std::uint64_t validBytes = 0;
+};
+
+// Rebuilds the document a journal describes. Fails only if the journal
+// itself is unreadable; when no logged save can be found intact the
+// records are replayed onto an empty document and `error` says why.
+bool replayJournal(const std::string& path, JournalReplay& replay, std::string& error);
+
+// A journal path no other session uses: the process id and start time.
+std::string sessionJournalPath();
+// Journals in the working directory, newest first. Some may belong to
+// sessions that are still running; claim() tells them apart.
+std::vector<std::string> findJournals();
+
+// Random non-zero id for a new save.
+std::uint32_t newSaveId();
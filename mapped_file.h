@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are loaded on first touch
+// and backed by the file itself, so mapping a large file costs neither time
+// nor private memory up front.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    const std::uint8_t* data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+private:
+    const std::uint8_t* bytes = nullptr;
+    std::size_t length = 0;
+};
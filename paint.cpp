@@ -1,25 +1,35 @@
 #include "imgui.h"
 #include "imgui-SFML.h"
+#include "shapes.h"
+#include "document.h"
+#include "document_io.h"
+#include "document_saver.h"
+#include "journal.h"
+#include "shape_batch.h"
+#include "shape_renderer.h"
+#include "spatial_index.h"
+#include "profiler.h"
+#include "tiled_canvas.h"
+#include "trace_recorder.h"
+#include "undo_history.h"
+#include "batch_render.h"
 
 #include <iostream>
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 
 #include <algorithm>
 
-struct Line {
-    sf::Vector2f start;
-    sf::Vector2f end;
-    sf::Color firstColor;
-    sf::Color secondColor;
-};
-
 enum ToolType {
     TOOL_LINE,
     TOOL_RECTANGLE,
     TOOL_FILLED_RECTANGLE,
-    TOOL_CIRCLE
+    TOOL_CIRCLE,
+    TOOL_SELECT
 };
 
 enum LineMode {
@@ -27,6 +37,52 @@ enum LineMode {
     LINE_MODE_GRADIENT
 };
 
+enum FileDialog {
+    FILE_DIALOG_NONE,
+    FILE_DIALOG_OPEN,
+    FILE_DIALOG_SAVE
+};
+
+enum Reorder {
+    REORDER_TO_FRONT,
+    REORDER_FORWARD,
+    REORDER_BACKWARD,
+    REORDER_TO_BACK
+};
+
+enum ToolInputType {
+    TOOL_INPUT_PRESS,
+    TOOL_INPUT_MOVE,
+    TOOL_INPUT_RELEASE
+};
+
+// Left-button mouse event for the active tool, already mapped to canvas
+// coordinates with the view that was current when the event arrived.
+struct ToolInput {
+    ToolInputType type;
+    sf::Vector2f position;
+};
+
+// Frames rendered after the last event before the loop may go idle, so
+// ImGui can settle hover and release states.
+constexpr int IDLE_SETTLE_FRAMES = 3;
+// How long an idle loop blocks before waking up for ImGui's caret blink
+// and hover tooltips.
+constexpr int IDLE_WAIT_MS = 250;
+
+struct FrameStats {
+    std::uint64_t rendered = 0;
+    std::uint64_t skipped = 0;
+};
+
+// Unsaved changes are written to the autosave file at most this often.
+constexpr float AUTOSAVE_INTERVAL_SECONDS = 60.0f;
+
+// World units per screen pixel.
+constexpr float MIN_ZOOM = 1.0f / 32.0f;
+constexpr float MAX_ZOOM = 32.0f;
+constexpr float ZOOM_STEP = 1.1f;
+
 class PaintApp {
 public:
     int selectedTool = TOOL_LINE;
@@ -38,14 +94,60 @@ public:
     bool isRectangleFilled = false;
     bool isDrawingCircle = false;
     float brushSize = 12.0f;
-    std::vector<Line> lines;
-    std::vector<sf::RectangleShape> rectangles;
+    bool isMemoryReportShown = false;
+    bool isFrameStatsShown = false;
+    bool isProfilerShown = false;
+    TraceRecorder traceRecorder;
+    char tracePath[256] = "paint-trace.json";
+    FileDialog fileDialog = FILE_DIALOG_NONE;
+    char filePath[512] = "drawing.pnt";
+    std::string currentFile;
+    std::string fileError;
+    // Declared before the saver, which may still wait on it while shutting down.
+    Journal journal;
+    // This session's journal, left behind only if it did not shut down cleanly.
+    std::string journalPath;
+    std::string recoveryNotice;
+    DocumentSaver documentSaver;
+    // Bumped by every change to the document; compared with the revisions
+    // that were last saved successfully to currentFile and to the autosave.
+    std::uint64_t documentRevision = 0;
+    std::uint64_t savedRevision = 0;
+    std::uint64_t autosavedRevision = 0;
+    // A save handed to the saver that has not reported back yet.
+    struct PendingSave {
+        std::uint64_t ticket;
+        std::uint64_t revision;
+        std::string path;
+        bool isAutosave;
+    };
+    std::vector<PendingSave> pendingSaves;
+    // Autosaves written this session; removed once an explicit save or a
+    // clean exit makes them redundant.
+    std::vector<std::string> autosaveFiles;
+    std::uint64_t shownSaveCount = 0;
+    sf::Clock autosaveClock;
+    FrameStats frameStats;
+    Document document;
+    UndoHistory undoHistory;
+    ShapeBatches shapeBatches;
+    ShapeRenderer shapeRenderer;
+    SpatialIndex spatialIndex;
+    std::vector<ShapeHandle> visibleShapes;
+    std::vector<sf::Vertex> strokeVertices;
+    std::vector<ToolInput> toolInputs;
+    TiledCanvas canvas{ [this](sf::RenderTarget& target, const sf::FloatRect& area) { drawCommittedShapes(target, area); } };
+    sf::View canvasView;
+    float viewZoom = 1.0f;
+    bool isPanning = false;
+    sf::Vector2i panLastPixel{};
     sf::Vector2f lineStart{}, lineEnd{};
     sf::Vector2f rectangleStart{}, rectangleEnd{};
     sf::RectangleShape tempRectangle;
-    std::vector<sf::CircleShape> circles;
     sf::Vector2f circleStart{}, circleEnd{};
     sf::CircleShape tempCircle;
+    std::optional<ShapeHandle> selectedShape;
+    sf::RectangleShape selectionOutline;
     sf::Color currentBorderColor = sf::Color::Black;
     sf::Color currentFillColor = sf::Color::Black;
 
@@ -60,37 +162,121 @@ public:
     void openFile(const std::string& filename);
     void saveFileAs(const std::string& filename);
     void exit();
+    void drawFileDialog();
+    void drawSaveStatus();
+    std::string autosavePath() const;
+    bool isAutosaveDue() const;
+    void autosave();
+    void startSave(const std::string& path, bool isAutosave);
+    void collectSaveResults();
+    void removeAutosaves();
+    void startJournal();
+    void rebuildFromDocument();
 
     void help();
     void drawToolsWindow(sf::RenderWindow& window);
     void keepImGuiWindowInside(const sf::RenderWindow& sfWindow, float margin = 0.0f);
-
-    void lineTool(sf::RenderWindow& window);
-    void rectangleTool(sf::RenderWindow& window, bool filled);
-    void circleTool(sf::RenderWindow& window);
-
-    void chosenTool(sf::RenderWindow& window);
+    void drawMemoryReportWindow();
+    void drawFrameStatsWindow();
+    void drawProfilerWindow();
+
+    void commitShape(const ShapeData& shape);
+    void restoreShape(ShapeHandle handle, const ShapeData& shape);
+    void shapeAdded(ShapeHandle handle);
+    void eraseShape(ShapeHandle handle);
+    void moveShape(ShapeHandle handle, std::optional<ShapeHandle> below);
+    void deleteSelection();
+    void reorderSelection(Reorder reorder);
+    std::optional<ShapeHandle> shapeAt(sf::Vector2f point) const;
+    void undo();
+    void redo();
+    void handleShortcut(const sf::Event& event);
+    void lineTool(const ToolInput& input);
+    void rectangleTool(const ToolInput& input, bool filled);
+    void circleTool(const ToolInput& input);
+    void selectTool(const ToolInput& input);
+
+    void resetView(sf::RenderWindow& window);
+    void handleViewEvent(sf::RenderWindow& window, const sf::Event& event);
+    sf::FloatRect visibleArea() const;
+
+    void queueToolInput(const sf::RenderWindow& window, const sf::Event& event);
+    bool isInteracting() const;
+    bool needsTimedRefresh() const;
+    void chosenTool();
+    void drawCommittedShapes(sf::RenderTarget& target, const sf::FloatRect& area);
     void renderCanvas(sf::RenderWindow& window);
 };
 
+namespace {
+// sf::Shape draws its fill fan and its outline strip separately.
+void countShapeDraw(const sf::Shape& shape) {
+    std::size_t points = shape.getPointCount();
+    Profiler::instance().countDraw(points + 2);
+    Profiler::instance().countDraw((points + 1) * 2);
+}
+}
+
 void PaintApp::menuBar(sf::RenderWindow& window) {
+    PROFILE_ZONE("menuBar");
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("File")) {
             if (ImGui::MenuItem("New", "Ctrl+N", false, true)) {
                 newFile(window);
             }
             if (ImGui::MenuItem("Open...", "Ctrl+O", false, true)) {
+                fileDialog = FILE_DIALOG_OPEN;
             }
             if (ImGui::MenuItem("Save As...", "Ctrl+S", false, true)) {
+                fileDialog = FILE_DIALOG_SAVE;
             }
             if (ImGui::MenuItem("Exit", "Alt+F4", false, true)) {
             }
             ImGui::EndMenu();
         }
+        if (ImGui::BeginMenu("Edit")) {
+            if (ImGui::MenuItem("Undo", "Ctrl+Z", false, undoHistory.canUndo())) {
+                undo();
+            }
+            if (ImGui::MenuItem("Redo", "Ctrl+Y", false, undoHistory.canRedo())) {
+                redo();
+            }
+            ImGui::Separator();
+            bool hasSelection = selectedShape.has_value();
+            if (ImGui::MenuItem("Delete", "Del", false, hasSelection)) {
+                deleteSelection();
+            }
+            ImGui::Separator();
+            if (ImGui::MenuItem("Bring to Front", "Ctrl+Shift+]", false, hasSelection)) {
+                reorderSelection(REORDER_TO_FRONT);
+            }
+            if (ImGui::MenuItem("Bring Forward", "Ctrl+]", false, hasSelection)) {
+                reorderSelection(REORDER_FORWARD);
+            }
+            if (ImGui::MenuItem("Send Backward", "Ctrl+[", false, hasSelection)) {
+                reorderSelection(REORDER_BACKWARD);
+            }
+            if (ImGui::MenuItem("Send to Back", "Ctrl+Shift+[", false, hasSelection)) {
+                reorderSelection(REORDER_TO_BACK);
+            }
+            ImGui::EndMenu();
+        }
         if (ImGui::BeginMenu("View")) {
             if (ImGui::MenuItem("Show Tool Options", "", isToolsShown)) {
                 isToolsShown = !isToolsShown;
             }
+            if (ImGui::MenuItem("Memory Report", "", isMemoryReportShown)) {
+                isMemoryReportShown = !isMemoryReportShown;
+            }
+            if (ImGui::MenuItem("Frame Statistics", "", isFrameStatsShown)) {
+                isFrameStatsShown = !isFrameStatsShown;
+            }
+            if (ImGui::MenuItem("Profiler", "", isProfilerShown)) {
+                isProfilerShown = !isProfilerShown;
+            }
+            if (ImGui::MenuItem("Reset View", "", false, true)) {
+                resetView(window);
+            }
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Help")) {
@@ -98,8 +284,182 @@ void PaintApp::menuBar(sf::RenderWindow& window) {
             }
             ImGui::EndMenu();
         }
+        drawSaveStatus();
         ImGui::EndMainMenuBar();
     }
+    drawFileDialog();
+}
+
+void PaintApp::drawSaveStatus() {
+    DocumentSaver::Status status = documentSaver.getStatus();
+    shownSaveCount = documentSaver.getFinishedCount();
+
+    ImGui::Separator();
+    switch (status.state) {
+    case DocumentSaver::State::Saving:
+        ImGui::Text("Saving %s... %d%%", status.path.c_str(), static_cast<int>(documentSaver.getProgress() * 100.0f));
+        break;
+    case DocumentSaver::State::Failed:
+        ImGui::TextColored(ImVec4(0.9f, 0.2f, 0.2f, 1.0f), "Save failed: %s", status.error.c_str());
+        break;
+    default:
+        if (!recoveryNotice.empty()) {
+            ImGui::TextColored(ImVec4(0.9f, 0.6f, 0.1f, 1.0f), "%s", recoveryNotice.c_str());
+        }
+        else if (documentRevision != savedRevision) {
+            ImGui::TextDisabled("Unsaved changes");
+        }
+        else if (status.state == DocumentSaver::State::Saved) {
+            ImGui::TextDisabled("Saved %s", status.path.c_str());
+        }
+        break;
+    }
+}
+
+std::string PaintApp::autosavePath() const {
+    return (currentFile.empty() ? std::string("untitled.pnt") : currentFile) + ".autosave";
+}
+
+bool PaintApp::isAutosaveDue() const {
+    return documentRevision != savedRevision && documentRevision != autosavedRevision && !documentSaver.isBusy() &&
+        autosaveClock.getElapsedTime().asSeconds() >= AUTOSAVE_INTERVAL_SECONDS;
+}
+
+// Only the snapshot copy happens here; writing it is the saver's job.
+void PaintApp::autosave() {
+    if (!isAutosaveDue()) return;
+
+    PROFILE_ZONE("autosave");
+    startSave(autosavePath(), true);
+}
+
+void PaintApp::startSave(const std::string& path, bool isAutosave) {
+    // The journal has to know about the save before the file is replaced,
+    // or a crash right after it would replay shapes the file already has.
+    std::uint32_t saveId = newSaveId();
+    std::uint64_t ticket = journal.appendSave(path, saveId);
+    // If the marker never reaches the disk, replacing the file would break
+    // replay, so the save is abandoned instead.
+    std::uint64_t saveTicket =
+        documentSaver.save(document, path, saveId, [this, ticket]() { return journal.waitUntilDurable(ticket); });
+    pendingSaves.push_back({ saveTicket, documentRevision, path, isAutosave });
+
+    recoveryNotice.clear();
+    autosaveClock.restart();
+}
+
+// The document only counts as saved once the saver reports success.
+void PaintApp::collectSaveResults() {
+    for (const DocumentSaver::Result& result : documentSaver.takeFinished()) {
+        auto found = std::find_if(pendingSaves.begin(), pendingSaves.end(),
+            [&](const PendingSave& save) { return save.ticket == result.ticket; });
+        if (found == pendingSaves.end()) continue;
+        PendingSave save = *found;
+        // Earlier ones were replaced before they started.
+        pendingSaves.erase(pendingSaves.begin(), found + 1);
+        if (!result.ok) continue;
+
+        // Revisions only grow, so saves of a document that has since been
+        // replaced by New or Open never count for the current one.
+        if (save.isAutosave) {
+            autosavedRevision = std::max(autosavedRevision, save.revision);
+            if (std::find(autosaveFiles.begin(), autosaveFiles.end(), save.path) == autosaveFiles.end()) {
+                autosaveFiles.push_back(save.path);
+            }
+        }
+        else if (save.revision >= savedRevision) {
+            // Save As only moves the document to its new file once the
+            // file has actually been written.
+            currentFile = save.path;
+            savedRevision = save.revision;
+            if (savedRevision >= autosavedRevision) removeAutosaves();
+        }
+    }
+}
+
+void PaintApp::removeAutosaves() {
+    for (const std::string& path : autosaveFiles) {
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    }
+    autosaveFiles.clear();
+}
+
+// Replays the newest journal a crashed session left behind, if any, then
+// keeps journaling into it; otherwise starts a fresh one for an empty
+// document. Journals still locked by a running session, or that cannot be
+// replayed, are left alone.
+void PaintApp::startJournal() {
+    for (const std::string& orphan : findJournals()) {
+        if (!journal.claim(orphan)) continue;
+
+        JournalReplay replay;
+        std::string error;
+        if (!replayJournal(orphan, replay, error)) {
+            // It may still be the only copy of that session's work, for
+            // instance a journal written by a newer version; keep it.
+            std::cerr << error << "; left in place" << std::endl;
+            journal.release();
+            continue;
+        }
+
+        if (!error.empty()) std::cerr << error << std::endl;
+        document = std::move(replay.document);
+        currentFile = replay.basePath;
+        std::string autosaveSuffix = ".autosave";
+        if (currentFile.size() > autosaveSuffix.size() &&
+            currentFile.compare(currentFile.size() - autosaveSuffix.size(), autosaveSuffix.size(), autosaveSuffix) == 0) {
+            currentFile.resize(currentFile.size() - autosaveSuffix.size());
+        }
+        ++documentRevision;
+        selectedShape.reset();
+        rebuildFromDocument();
+        recoveryNotice = "Recovered " + std::to_string(replay.appliedRecords) + " unsaved changes";
+        journalPath = orphan;
+        if (journal.resume(journalPath, replay.validBytes)) return;
+        break;
+    }
+
+    journalPath = sessionJournalPath();
+    if (!journal.start(journalPath, currentFile, 0)) {
+        std::cerr << "Could not create " << journalPath << "; crash recovery is off" << std::endl;
+    }
+}
+
+void PaintApp::drawFileDialog() {
+    // Popups have to be opened from the same ID stack level they are drawn
+    // at, so the menu only records which one was asked for.
+    const char* title = fileDialog == FILE_DIALOG_OPEN ? "Open Document" : "Save Document As";
+    if (fileDialog != FILE_DIALOG_NONE && !ImGui::IsPopupOpen(title)) {
+        if (!currentFile.empty()) std::snprintf(filePath, sizeof(filePath), "%s", currentFile.c_str());
+        fileError.clear();
+        ImGui::OpenPopup(title);
+    }
+
+    if (ImGui::BeginPopupModal(title, nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::SetNextItemWidth(400.0f);
+        bool submitted = ImGui::InputText("Path", filePath, sizeof(filePath), ImGuiInputTextFlags_EnterReturnsTrue);
+        if (!fileError.empty()) ImGui::TextColored(ImVec4(0.9f, 0.2f, 0.2f, 1.0f), "%s", fileError.c_str());
+
+        submitted |= ImGui::Button(fileDialog == FILE_DIALOG_OPEN ? "Open" : "Save");
+        ImGui::SameLine();
+        bool cancelled = ImGui::Button("Cancel");
+
+        if (submitted) {
+            fileError.clear();
+            if (fileDialog == FILE_DIALOG_OPEN) {
+                openFile(filePath);
+            }
+            else {
+                saveFileAs(filePath);
+            }
+        }
+        if (cancelled || (submitted && fileError.empty())) {
+            fileDialog = FILE_DIALOG_NONE;
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::EndPopup();
+    }
 }
 
 void PaintApp::keepImGuiWindowInside(const sf::RenderWindow& sfWindow, float margin) {
@@ -133,7 +493,107 @@ void PaintApp::keepImGuiWindowInside(const sf::RenderWindow& sfWindow, float mar
     }
 }
 
+void PaintApp::drawMemoryReportWindow() {
+    if (!isMemoryReportShown) return;
+
+    ImGui::SetNextWindowSize(ImVec2(420, 200), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Memory Report", &isMemoryReportShown)) {
+        if (ImGui::BeginTable("memory", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Shape");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("Bytes/shape (SFML)");
+            ImGui::TableSetupColumn("Bytes/shape (packed)");
+            ImGui::TableSetupColumn("Total KiB");
+            ImGui::TableHeadersRow();
+
+            for (const MemoryReportRow& row : memoryReport(document)) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(row.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", row.count);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", row.bytesPerShapeBefore);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", row.bytesPerShapeAfter);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", row.bytesUsed / 1024.0);
+            }
+            ImGui::EndTable();
+        }
+
+        ImGui::Text("Shape batches: %.1f KiB, plus %.1f MiB on the GPU", shapeBatches.bytesUsed() / 1024.0,
+            shapeBatches.gpuBytesUsed() / (1024.0 * 1024.0));
+        ImGui::Text("Undo history: %zu steps, %.1f KiB", undoHistory.size(), undoHistory.getMemoryUsed() / 1024.0);
+        int budgetMiB = static_cast<int>(undoHistory.getMemoryBudget() >> 20);
+        if (ImGui::SliderInt("Undo budget (MiB)", &budgetMiB, 1, 1024)) {
+            undoHistory.setMemoryBudget(static_cast<std::size_t>(budgetMiB) << 20);
+        }
+    }
+    ImGui::End();
+}
+
+void PaintApp::drawFrameStatsWindow() {
+    if (!isFrameStatsShown) return;
+
+    ImGui::SetNextWindowSize(ImVec2(260, 100), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Frame Statistics", &isFrameStatsShown)) {
+        std::uint64_t total = frameStats.rendered + frameStats.skipped;
+        ImGui::Text("Rendered frames: %llu", static_cast<unsigned long long>(frameStats.rendered));
+        ImGui::Text("Skipped frames:  %llu", static_cast<unsigned long long>(frameStats.skipped));
+        ImGui::Text("Idle: %.1f%%", total ? 100.0 * frameStats.skipped / total : 0.0);
+    }
+    ImGui::End();
+}
+
+void PaintApp::drawProfilerWindow() {
+    if (!isProfilerShown) return;
+
+    const Profiler& profiler = Profiler::instance();
+    ImGui::SetNextWindowSize(ImVec2(360, 320), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Profiler", &isProfilerShown)) {
+        ImGui::Text("Frame: %.2f ms", profiler.getLastFrameMs());
+        ImGui::PlotLines("##frameTimes", profiler.getFrameTimes(), static_cast<int>(Profiler::FRAME_HISTORY),
+            profiler.getFrameTimeOffset(), nullptr, 0.0f, 33.3f, ImVec2(-1.0f, 60.0f));
+        ImGui::Text("Draw calls: %u", profiler.getDrawCalls());
+        ImGui::Text("Vertices: %llu", static_cast<unsigned long long>(profiler.getVertexCount()));
+
+        if (traceRecorder.isRecording()) {
+            if (ImGui::Button("Stop Trace")) traceRecorder.stop();
+            ImGui::SameLine();
+            ImGui::Text("%llu events", static_cast<unsigned long long>(traceRecorder.getEventCount()));
+        }
+        else {
+            if (ImGui::Button("Record Trace") && !traceRecorder.start(tracePath)) {
+                std::cerr << "Could not open trace file " << tracePath << std::endl;
+            }
+            ImGui::SameLine();
+            ImGui::InputText("##tracePath", tracePath, sizeof(tracePath));
+        }
+
+        if (ImGui::BeginTable("phases", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Phase");
+            ImGui::TableSetupColumn("Last ms");
+            ImGui::TableSetupColumn("Avg ms");
+            ImGui::TableHeadersRow();
+
+            for (const PhaseStats& phase : profiler.getPhases()) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(phase.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", phase.lastMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", phase.averageMs);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
 void PaintApp::drawToolsWindow(sf::RenderWindow& window) {
+    PROFILE_ZONE("drawToolsWindow");
     if (!isToolsShown) return;
 
     ImGui::SetNextWindowPos(ImVec2(20, 60), ImGuiCond_FirstUseEver);
@@ -154,6 +614,7 @@ void PaintApp::drawToolsWindow(sf::RenderWindow& window) {
         ImGui::RadioButton("Rectangle", &selectedTool, TOOL_RECTANGLE);
         ImGui::RadioButton("Filled Rectangle", &selectedTool, TOOL_FILLED_RECTANGLE);
         ImGui::RadioButton("Circle", &selectedTool, TOOL_CIRCLE);
+        ImGui::RadioButton("Select", &selectedTool, TOOL_SELECT);
         ImGui::SliderFloat("Brush Size", &brushSize, 1.0f, 100.0f);
 
         ImGui::Separator();
@@ -185,40 +646,263 @@ void PaintApp::drawToolsWindow(sf::RenderWindow& window) {
     ImGui::PopStyleColor(3);
 }
 
-void PaintApp::chosenTool(sf::RenderWindow& window) {
+void PaintApp::queueToolInput(const sf::RenderWindow& window, const sf::Event& event) {
+    if (const auto* pressed = event.getIf<sf::Event::MouseButtonPressed>()) {
+        if (pressed->button != sf::Mouse::Button::Left || ImGui::GetIO().WantCaptureMouse) return;
+        toolInputs.push_back({ TOOL_INPUT_PRESS, window.mapPixelToCoords(pressed->position, canvasView) });
+    }
+    else if (const auto* moved = event.getIf<sf::Event::MouseMoved>()) {
+        toolInputs.push_back({ TOOL_INPUT_MOVE, window.mapPixelToCoords(moved->position, canvasView) });
+    }
+    else if (const auto* released = event.getIf<sf::Event::MouseButtonReleased>()) {
+        if (released->button != sf::Mouse::Button::Left) return;
+        toolInputs.push_back({ TOOL_INPUT_RELEASE, window.mapPixelToCoords(released->position, canvasView) });
+    }
+}
+
+bool PaintApp::isInteracting() const {
+    return isDrawingLine || isDrawingRectangle || isDrawingCircle || isPanning || ImGui::IsAnyItemActive();
+}
+
+bool PaintApp::needsTimedRefresh() const {
+    // The text caret blinks and tooltips appear on a timer, without events.
     ImGuiIO& io = ImGui::GetIO();
-    if (io.WantCaptureMouse) {
-        return;
+    // Save progress and completion are not events either.
+    return io.WantTextInput || ImGui::IsAnyItemHovered() || documentSaver.isBusy() ||
+        documentSaver.getFinishedCount() != shownSaveCount || isAutosaveDue();
+}
+
+void PaintApp::chosenTool() {
+    PROFILE_ZONE("chosenTool");
+    for (const ToolInput& input : toolInputs) {
+        switch (selectedTool) {
+        case TOOL_LINE:
+            lineTool(input);
+            break;
+        case TOOL_RECTANGLE:
+            rectangleTool(input, false);
+            break;
+        case TOOL_FILLED_RECTANGLE:
+            rectangleTool(input, true);
+            break;
+        case TOOL_CIRCLE:
+            circleTool(input);
+            break;
+        case TOOL_SELECT:
+            selectTool(input);
+            break;
+        default:
+            break;
+        }
+    }
+    toolInputs.clear();
+}
+
+void PaintApp::commitShape(const ShapeData& shape) {
+    ShapeHandle handle = document.add(shape);
+    shapeAdded(handle);
+    undoHistory.push({ EditCommand::Type::AddShape, shape, handle, std::nullopt, std::nullopt });
+}
+
+// Brings an erased shape back on top, under the handle it had before, so
+// history entries that refer to it stay valid.
+void PaintApp::restoreShape(ShapeHandle handle, const ShapeData& shape) {
+    document.restore(handle, shape);
+    shapeAdded(handle);
+}
+
+// Logs a shape the document just put on top, updates the derived state and
+// paints the shape straight onto the cached tiles.
+void PaintApp::shapeAdded(ShapeHandle handle) {
+    ShapeRef shape = *document.find(handle);
+    sf::FloatRect bounds = document.bounds(shape);
+    std::size_t i = shape.index;
+    ++documentRevision;
+    spatialIndex.insert(handle, bounds);
+
+    switch (shape.kind) {
+    case ShapeKind::Line: {
+        const Line& line = document.lines[i];
+        journal.appendLine(line);
+        strokeVertices.clear();
+        tessellateLine(line, strokeVertices);
+        canvas.paint(bounds, [this](sf::RenderTarget& target) {
+            target.draw(strokeVertices.data(), strokeVertices.size(), sf::PrimitiveType::Triangles);
+        });
+        break;
+    }
+    case ShapeKind::Rectangle:
+        journal.appendRectangle(document.rectangles, i);
+        canvas.paint(bounds, [&](sf::RenderTarget& target) {
+            shapeRenderer.drawRectangle(target, document.rectangles, i);
+        });
+        break;
+    case ShapeKind::Circle:
+        journal.appendCircle(document.circles, i);
+        canvas.paint(bounds, [&](sf::RenderTarget& target) {
+            shapeRenderer.drawCircle(target, document.circles, i);
+        });
+        break;
+    }
+}
+
+// O(1) in the document; only the tiles the shape covered get redrawn.
+void PaintApp::eraseShape(ShapeHandle handle) {
+    ShapeRef shape = *document.find(handle);
+    sf::FloatRect bounds = document.bounds(shape);
+    if (selectedShape == handle) selectedShape.reset();
+
+    spatialIndex.remove(handle, bounds);
+    journal.appendErase(shape);
+    document.erase(shape);
+    shapeBatches.erase(handle);
+    ++documentRevision;
+    canvas.invalidate(bounds);
+}
+
+void PaintApp::moveShape(ShapeHandle handle, std::optional<ShapeHandle> below) {
+    ShapeRef shape = *document.find(handle);
+    std::optional<ShapeRef> belowShape = below ? document.find(*below) : std::nullopt;
+    document.order.place(shape, belowShape);
+    journal.appendMove(shape, belowShape);
+    ++documentRevision;
+    canvas.invalidate(document.bounds(shape));
+}
+
+void PaintApp::deleteSelection() {
+    if (!selectedShape) return;
+
+    ShapeHandle handle = *selectedShape;
+    ShapeData shape = document.get(*document.find(handle));
+    std::optional<ShapeHandle> below = document.below(handle);
+    eraseShape(handle);
+    undoHistory.push({ EditCommand::Type::EraseShape, shape, handle, below, std::nullopt });
+}
+
+// Forward and backward step past the nearest shape that overlaps the
+// selection; stepping past one it does not overlap would change nothing
+// on screen.
+void PaintApp::reorderSelection(Reorder reorder) {
+    if (!selectedShape) return;
+
+    ShapeHandle handle = *selectedShape;
+    ShapeRef shape = *document.find(handle);
+    std::optional<ShapeHandle> belowBefore = document.below(handle);
+    std::optional<ShapeHandle> belowAfter;
+
+    if (reorder == REORDER_TO_FRONT) {
+        belowAfter = document.top();
+    }
+    else if (reorder == REORDER_FORWARD || reorder == REORDER_BACKWARD) {
+        std::vector<ShapeHandle> overlapping;
+        spatialIndex.queryRect(document.bounds(shape), overlapping);
+        std::uint64_t depth = document.order.depthOf(shape);
+        std::optional<ShapeHandle> nearest;
+        std::uint64_t nearestDepth = 0;
+        for (ShapeHandle other : overlapping) {
+            std::uint64_t otherDepth = document.order.depthOf(*document.find(other));
+            bool isCandidate = reorder == REORDER_FORWARD ? otherDepth > depth : otherDepth < depth;
+            bool isNearer = !nearest ||
+                (reorder == REORDER_FORWARD ? otherDepth < nearestDepth : otherDepth > nearestDepth);
+            if (isCandidate && isNearer) {
+                nearest = other;
+                nearestDepth = otherDepth;
+            }
+        }
+        if (!nearest) return;
+        belowAfter = reorder == REORDER_FORWARD ? nearest : document.below(*nearest);
+    }
+
+    if (belowAfter == handle || belowAfter == belowBefore) return;
+    moveShape(handle, belowAfter);
+    undoHistory.push({ EditCommand::Type::MoveShape, {}, handle, belowBefore, belowAfter });
+}
+
+// Topmost shape whose bounds contain `point`.
+std::optional<ShapeHandle> PaintApp::shapeAt(sf::Vector2f point) const {
+    std::vector<ShapeHandle> hits;
+    spatialIndex.queryPoint(point, hits);
+    if (hits.empty()) return std::nullopt;
+    document.sortByDepth(hits);
+    return hits.back();
+}
+
+void PaintApp::undo() {
+    const EditCommand* command = undoHistory.undo();
+    if (!command) return;
+
+    PROFILE_ZONE("undo");
+    switch (command->type) {
+    case EditCommand::Type::AddShape:
+        eraseShape(command->handle);
+        break;
+    case EditCommand::Type::EraseShape:
+        restoreShape(command->handle, command->shape);
+        moveShape(command->handle, command->belowBefore);
+        break;
+    case EditCommand::Type::MoveShape:
+        moveShape(command->handle, command->belowBefore);
+        break;
     }
+}
+
+void PaintApp::redo() {
+    const EditCommand* command = undoHistory.redo();
+    if (!command) return;
+
+    PROFILE_ZONE("redo");
+    switch (command->type) {
+    case EditCommand::Type::AddShape:
+        restoreShape(command->handle, command->shape);
+        break;
+    case EditCommand::Type::EraseShape:
+        eraseShape(command->handle);
+        break;
+    case EditCommand::Type::MoveShape:
+        moveShape(command->handle, command->belowAfter);
+        break;
+    }
+}
 
-    switch (selectedTool) {
-    case TOOL_LINE:
-        lineTool(window);
+void PaintApp::handleShortcut(const sf::Event& event) {
+    const auto* pressed = event.getIf<sf::Event::KeyPressed>();
+    if (!pressed || ImGui::GetIO().WantTextInput) return;
+    bool isDelete = pressed->code == sf::Keyboard::Key::Delete;
+    if (!pressed->control && !isDelete) return;
+
+    // Mouse input queued before the key press goes first, so an undo never
+    // overtakes the shape it is meant to revert.
+    chosenTool();
+    if (isDelete) {
+        deleteSelection();
+        return;
+    }
+    switch (pressed->code) {
+    case sf::Keyboard::Key::Z:
+        if (pressed->shift) redo();
+        else undo();
         break;
-    case TOOL_RECTANGLE:
-        rectangleTool(window, false);
+    case sf::Keyboard::Key::Y:
+        redo();
         break;
-    case TOOL_FILLED_RECTANGLE:
-        rectangleTool(window, true);
+    case sf::Keyboard::Key::RBracket:
+        reorderSelection(pressed->shift ? REORDER_TO_FRONT : REORDER_FORWARD);
         break;
-    case TOOL_CIRCLE:
-        circleTool(window);
+    case sf::Keyboard::Key::LBracket:
+        reorderSelection(pressed->shift ? REORDER_TO_BACK : REORDER_BACKWARD);
         break;
     default:
         break;
     }
 }
 
-void PaintApp::lineTool(sf::RenderWindow& window) {
+void PaintApp::lineTool(const ToolInput& input) {
     if (selectedTool != TOOL_LINE) return;
 
-    sf::Vector2f mouse = window.mapPixelToCoords(sf::Mouse::getPosition(window));
-
-    static bool previousMouseState = false;
-    bool pressed = sf::Mouse::isButtonPressed(sf::Mouse::Button::Left);
+    sf::Vector2f mouse = input.position;
 
     if (!isDrawingLine) {
-        if (pressed && !previousMouseState) {
+        if (input.type == TOOL_INPUT_PRESS) {
             isDrawingLine = true;
             lineStart = lineEnd = mouse;
         }
@@ -226,14 +910,15 @@ void PaintApp::lineTool(sf::RenderWindow& window) {
     else {
         lineEnd = mouse;
 
-        if (!pressed && previousMouseState) {
+        if (input.type == TOOL_INPUT_RELEASE) {
             if (selectedLineMode == LINE_MODE_ONE_COLOR) {
                 isLineGradient = false;
                 Line L;
                 L.start = lineStart;
                 L.end = lineEnd;
                 L.firstColor = L.secondColor = currentBorderColor;
-                lines.push_back(L);
+                L.thickness = brushSize;
+                commitShape(L);
             }
             else if (selectedLineMode == LINE_MODE_GRADIENT) {
                 isLineGradient = true;
@@ -242,28 +927,24 @@ void PaintApp::lineTool(sf::RenderWindow& window) {
                 L.end = lineEnd;
                 L.firstColor = currentBorderColor;
                 L.secondColor = currentFillColor;
-                lines.push_back(L);
+                L.thickness = brushSize;
+                commitShape(L);
             }
             isDrawingLine = false;
         }
     }
-
-    previousMouseState = pressed;
 }
 
-void PaintApp::rectangleTool(sf::RenderWindow& window, bool filled) {
+void PaintApp::rectangleTool(const ToolInput& input, bool filled) {
     if (selectedTool != TOOL_RECTANGLE && selectedTool != TOOL_FILLED_RECTANGLE) return;
 
     if (filled) isRectangleFilled = true;
     else isRectangleFilled = false;
 
-    sf::Vector2f mouse = window.mapPixelToCoords(sf::Mouse::getPosition(window));
-
-    static bool previousMouseState = false;
-    bool pressed = sf::Mouse::isButtonPressed(sf::Mouse::Button::Left);
+    sf::Vector2f mouse = input.position;
 
     if (!isDrawingRectangle) {
-        if (pressed && !previousMouseState) {
+        if (input.type == TOOL_INPUT_PRESS) {
             isDrawingRectangle = true;
             rectangleStart = rectangleEnd = mouse;
         }
@@ -271,40 +952,29 @@ void PaintApp::rectangleTool(sf::RenderWindow& window, bool filled) {
     else {
         rectangleEnd = mouse;
 
-        if (!pressed && previousMouseState) {
-            sf::RectangleShape rect;
-            rect.setPosition(sf::Vector2f(
+        if (input.type == TOOL_INPUT_RELEASE) {
+            sf::Vector2f position(
                 std::min(rectangleStart.x, rectangleEnd.x),
                 std::min(rectangleStart.y, rectangleEnd.y)
-            ));
-            rect.setSize(sf::Vector2f(
+            );
+            sf::Vector2f size(
                 std::abs(rectangleEnd.x - rectangleStart.x),
                 std::abs(rectangleEnd.y - rectangleStart.y)
-            ));
-            if (filled)
-                rect.setFillColor(currentFillColor);
-            else
-                rect.setFillColor(sf::Color::Transparent);
-            rect.setOutlineColor(currentBorderColor);
-            rect.setOutlineThickness(brushSize);
-            rectangles.push_back(rect);
+            );
+            sf::Color fill = filled ? currentFillColor : sf::Color::Transparent;
+            commitShape(RectangleData{ position, size, fill, currentBorderColor, brushSize });
             isDrawingRectangle = false;
         }
     }
-
-    previousMouseState = pressed;
 }
 
-void PaintApp::circleTool(sf::RenderWindow& window) {
+void PaintApp::circleTool(const ToolInput& input) {
     if (selectedTool != TOOL_CIRCLE) return;
 
-    sf::Vector2f mouse = window.mapPixelToCoords(sf::Mouse::getPosition(window));
-
-    static bool previousMouseState = false;
-    bool pressed = sf::Mouse::isButtonPressed(sf::Mouse::Button::Left);
+    sf::Vector2f mouse = input.position;
 
     if (!isDrawingCircle) {
-        if (pressed && !previousMouseState) {
+        if (input.type == TOOL_INPUT_PRESS) {
             isDrawingCircle = true;
             circleStart = circleEnd = mouse;
         }
@@ -312,58 +982,107 @@ void PaintApp::circleTool(sf::RenderWindow& window) {
     else {
         circleEnd = mouse;
 
-        if (!pressed && previousMouseState) {
+        if (input.type == TOOL_INPUT_RELEASE) {
             float radius = std::sqrt(
                 std::pow(circleEnd.x - circleStart.x, 2) +
                 std::pow(circleEnd.y - circleStart.y, 2)
             );
-            sf::CircleShape circle(radius);
-            circle.setPosition(sf::Vector2f(
-                circleStart.x - radius,
-                circleStart.y - radius
-            ));
-            circle.setFillColor(sf::Color::Transparent);
-            circle.setOutlineColor(currentBorderColor);
-            circle.setOutlineThickness(brushSize);
-            circles.push_back(circle);
+            commitShape(CircleData{ circleStart, radius, currentBorderColor, brushSize });
             isDrawingCircle = false;
         }
     }
+}
 
-    previousMouseState = pressed;
+void PaintApp::selectTool(const ToolInput& input) {
+    if (selectedTool != TOOL_SELECT || input.type != TOOL_INPUT_PRESS) return;
+    selectedShape = shapeAt(input.position);
 }
 
-void PaintApp::renderCanvas(sf::RenderWindow& window) {
-    for (const auto& line : lines) {
-        sf::Vertex v[2];
-        v[0].position = line.start;
-        v[0].color = line.firstColor;
-        v[1].position = line.end;
-        v[1].color = line.secondColor;
-        window.draw(v, 2, sf::PrimitiveType::Lines);
-    }
+void PaintApp::resetView(sf::RenderWindow& window) {
+    viewZoom = 1.0f;
+    isPanning = false;
+    sf::Vector2f size(window.getSize());
+    canvasView = sf::View(sf::FloatRect({ 0.0f, 0.0f }, size));
+    window.setView(canvasView);
+}
 
-    for (const auto& rect : rectangles) {
-        window.draw(rect);
+void PaintApp::handleViewEvent(sf::RenderWindow& window, const sf::Event& event) {
+    bool imguiHasMouse = ImGui::GetIO().WantCaptureMouse;
+
+    if (const auto* resized = event.getIf<sf::Event::Resized>()) {
+        canvasView.setSize(sf::Vector2f(resized->size) * viewZoom);
+    }
+    else if (const auto* scrolled = event.getIf<sf::Event::MouseWheelScrolled>()) {
+        if (imguiHasMouse || scrolled->wheel != sf::Mouse::Wheel::Vertical) return;
+
+        // Zoom around the cursor: the world point under it stays put.
+        sf::Vector2f before = window.mapPixelToCoords(scrolled->position, canvasView);
+        viewZoom = std::clamp(viewZoom * std::pow(ZOOM_STEP, -scrolled->delta), MIN_ZOOM, MAX_ZOOM);
+        canvasView.setSize(sf::Vector2f(window.getSize()) * viewZoom);
+        sf::Vector2f after = window.mapPixelToCoords(scrolled->position, canvasView);
+        canvasView.move(before - after);
+    }
+    else if (const auto* pressed = event.getIf<sf::Event::MouseButtonPressed>()) {
+        if (imguiHasMouse) return;
+        if (pressed->button == sf::Mouse::Button::Middle || pressed->button == sf::Mouse::Button::Right) {
+            isPanning = true;
+            panLastPixel = pressed->position;
+        }
+    }
+    else if (const auto* released = event.getIf<sf::Event::MouseButtonReleased>()) {
+        if (released->button == sf::Mouse::Button::Middle || released->button == sf::Mouse::Button::Right) {
+            isPanning = false;
+        }
+    }
+    else if (const auto* moved = event.getIf<sf::Event::MouseMoved>()) {
+        if (!isPanning) return;
+        canvasView.move(window.mapPixelToCoords(panLastPixel, canvasView) - window.mapPixelToCoords(moved->position, canvasView));
+        panLastPixel = moved->position;
     }
+    else {
+        return;
+    }
+
+    window.setView(canvasView);
+}
+
+sf::FloatRect PaintApp::visibleArea() const {
+    return sf::FloatRect(canvasView.getCenter() - canvasView.getSize() / 2.0f, canvasView.getSize());
+}
 
-    for (const auto& circle : circles) {
-        window.draw(circle);
+void PaintApp::drawCommittedShapes(sf::RenderTarget& target, const sf::FloatRect& area) {
+    visibleShapes.clear();
+    spatialIndex.queryRect(area, visibleShapes);
+    document.sortByDepth(visibleShapes);
+    shapeRenderer.draw(target, document, shapeBatches, visibleShapes);
+}
+
+void PaintApp::renderCanvas(sf::RenderWindow& window) {
+    PROFILE_ZONE("renderCanvas");
+    sf::FloatRect visible = visibleArea();
+
+    canvas.setScale(1.0f / viewZoom);
+    shapeRenderer.setScale(1.0f / viewZoom);
+    canvas.update(visible);
+    if (canvas.isReady()) {
+        canvas.present(window, visible);
+    }
+    else {
+        drawCommittedShapes(window, visible);
     }
 
     if (isDrawingLine) {
-        sf::Vertex v[2];
-        if (isLineGradient) {
-            v[0].color = currentBorderColor;
-            v[1].color = currentFillColor;
-        }
-        else {
-            v[0].color = currentBorderColor;
-            v[1].color = currentBorderColor;
-        }
-        v[0].position = lineStart;
-        v[1].position = lineEnd;
-        window.draw(v, 2, sf::PrimitiveType::Lines);
+        Line preview;
+        preview.start = lineStart;
+        preview.end = lineEnd;
+        preview.firstColor = currentBorderColor;
+        preview.secondColor = isLineGradient ? currentFillColor : currentBorderColor;
+        preview.thickness = brushSize;
+
+        strokeVertices.clear();
+        tessellateLine(preview, strokeVertices);
+        window.draw(strokeVertices.data(), strokeVertices.size(), sf::PrimitiveType::Triangles);
+        Profiler::instance().countDraw(strokeVertices.size());
     }
 
     if (isDrawingRectangle) {
@@ -384,6 +1103,7 @@ void PaintApp::renderCanvas(sf::RenderWindow& window) {
         tempRectangle.setOutlineThickness(brushSize);
 
         window.draw(tempRectangle);
+        countShapeDraw(tempRectangle);
     }
 
     if (isDrawingCircle) {
@@ -392,6 +1112,7 @@ void PaintApp::renderCanvas(sf::RenderWindow& window) {
             std::pow(circleEnd.y - circleStart.y, 2)
         );
         tempCircle.setRadius(radius);
+        tempCircle.setPointCount(circlePointCount((radius + brushSize) / viewZoom));
         tempCircle.setPosition(sf::Vector2f(
             circleStart.x - radius,
             circleStart.y - radius
@@ -400,14 +1121,80 @@ void PaintApp::renderCanvas(sf::RenderWindow& window) {
         tempCircle.setOutlineColor(currentBorderColor);
         tempCircle.setOutlineThickness(brushSize);
         window.draw(tempCircle);
+        countShapeDraw(tempCircle);
+    }
+
+    if (selectedShape) {
+        sf::FloatRect bounds = document.bounds(*document.find(*selectedShape));
+        selectionOutline.setPosition(bounds.position);
+        selectionOutline.setSize(bounds.size);
+        selectionOutline.setFillColor(sf::Color::Transparent);
+        selectionOutline.setOutlineColor(sf::Color(0, 120, 215));
+        // One screen pixel at any zoom.
+        selectionOutline.setOutlineThickness(viewZoom);
+        window.draw(selectionOutline);
+        countShapeDraw(selectionOutline);
     }
 }
 
 void PaintApp::newFile(sf::RenderWindow& window) {
+    document.clear();
+    undoHistory.clear();
+    selectedShape.reset();
+    currentFile.clear();
+    savedRevision = ++documentRevision;
+    recoveryNotice.clear();
+    journal.start(journalPath, "", 0);
+    rebuildFromDocument();
     window.clear(sf::Color::White);
 }
 
-int main() {
+void PaintApp::openFile(const std::string& filename) {
+    Document loaded;
+    if (!loadDocument(filename, loaded, fileError)) return;
+
+    document = std::move(loaded);
+    undoHistory.clear();
+    selectedShape.reset();
+    currentFile = filename;
+    savedRevision = ++documentRevision;
+    recoveryNotice.clear();
+
+    std::uint32_t saveId = 0;
+    readDocumentSaveId(filename, saveId);
+    journal.start(journalPath, filename, saveId);
+    rebuildFromDocument();
+}
+
+void PaintApp::saveFileAs(const std::string& filename) {
+#ifdef _WIN32
+    // Windows refuses to replace a file that is still mapped.
+    if (filename == currentFile) document.detach();
+#endif
+    startSave(filename, false);
+}
+
+// Derived state (shape batches, spatial index, cached tiles) after the
+// document was replaced wholesale.
+void PaintApp::rebuildFromDocument() {
+    shapeBatches.clear();
+
+    spatialIndex.clear();
+    for (std::size_t k = 0; k < SHAPE_KIND_COUNT; ++k) {
+        auto kind = static_cast<ShapeKind>(k);
+        for (std::uint32_t i = 0; i < document.count(kind); ++i) {
+            spatialIndex.insert(document.handleOf({ kind, i }), document.bounds({ kind, i }));
+        }
+    }
+
+    canvas.invalidateAll();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--render") == 0) {
+        return runBatchRender(argc - 2, argv + 2);
+    }
+
     sf::RenderWindow window(sf::VideoMode({ 1800, 900 }), "ImGui + SFML");
     sf::Clock deltaClock;
     PaintApp app;
@@ -421,22 +1208,81 @@ int main() {
     style.FrameRounding = 4.0f;
     style.GrabRounding = 4.0f;
 
+    app.resetView(window);
+    app.startJournal();
+
+    auto processEvent = [&](const sf::Event& event) {
+        ImGui::SFML::ProcessEvent(window, event);
+        if (event.is<sf::Event::Closed>()) window.close();
+        app.handleViewEvent(window, event);
+        app.queueToolInput(window, event);
+        app.handleShortcut(event);
+    };
+
+    int settleFrames = IDLE_SETTLE_FRAMES;
     while (window.isOpen()) {
-        while (const auto event = window.pollEvent()) {
-            ImGui::SFML::ProcessEvent(window, *event);
-            if (event->is<sf::Event::Closed>()) window.close();
+        bool hadEvents = false;
+
+        // Nothing can change until the next event, so block instead of
+        // redrawing an identical frame.
+        if (settleFrames == 0 && !app.isInteracting()) {
+            if (const auto event = window.waitEvent(sf::milliseconds(IDLE_WAIT_MS))) {
+                processEvent(*event);
+                hadEvents = true;
+            }
+            else if (!app.needsTimedRefresh()) {
+                ++app.frameStats.skipped;
+                continue;
+            }
         }
 
+        Profiler::instance().beginFrame();
+        {
+            PROFILE_ZONE("pollEvents");
+            while (const auto event = window.pollEvent()) {
+                processEvent(*event);
+                hadEvents = true;
+            }
+        }
+        if (!window.isOpen()) break;
+        settleFrames = hadEvents ? IDLE_SETTLE_FRAMES : std::max(settleFrames - 1, 0);
+
         ImGui::SFML::Update(window, deltaClock.restart());
-        app.chosenTool(window);
+        app.chosenTool();
+        app.collectSaveResults();
+        app.autosave();
 
         app.menuBar(window);
         app.drawToolsWindow(window);
+        app.drawMemoryReportWindow();
+        app.drawFrameStatsWindow();
+        app.drawProfilerWindow();
         window.clear(sf::Color::White);
         app.renderCanvas(window);
-        ImGui::SFML::Render(window);
-        window.display();
+        {
+            PROFILE_ZONE("ImGui::SFML::Render");
+            ImGui::SFML::Render(window);
+        }
+        {
+            // Includes the vsync / frame limiter wait.
+            PROFILE_ZONE("window.display");
+            window.display();
+        }
+        ++app.frameStats.rendered;
+        Profiler::instance().endFrame();
     }
     ImGui::SFML::Shutdown();
+    // A save still running would put the autosave back after it is removed.
+    app.documentSaver.waitUntilIdle();
+    app.collectSaveResults();
+    // If the last save failed, the journal and autosaves may be the only
+    // copy of the work, so they are kept for the next launch to recover.
+    if (app.documentSaver.getStatus().state == DocumentSaver::State::Failed) {
+        app.journal.stop();
+    }
+    else {
+        app.removeAutosaves();
+        app.journal.discard();
+    }
     return 0;
 }
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Array of trivially copyable values that either owns its elements or
+// views elements that live elsewhere, typically a memory-mapped document
+// file. Reads work the same either way; the first mutation copies a view
+// into owned storage, so opening a file costs nothing per shape and only
+// documents that get edited pay for the copy.
+//
+// Copying an array is O(1): the copy is a view of the original's elements
+// and shares their buffer. The original can keep appending, because new
+// elements land past the end of every copy; anything that would overwrite
+// elements a copy can still see moves the original to a fresh buffer
+// first. That makes a copy a consistent snapshot another thread can read
+// while the original keeps changing.
+template <typename T>
+class PodArray {
+    static_assert(std::is_trivially_copyable_v<T>, "PodArray elements are used straight from file bytes");
+
+public:
+    PodArray() = default;
+    PodArray(const PodArray& other) { *this = other; }
+    PodArray(PodArray&& other) noexcept { *this = std::move(other); }
+    // Leaves `other` empty, not holding a size with no elements behind it.
+    PodArray& operator=(PodArray&& other) noexcept {
+        if (this == &other) return *this;
+        buffer = std::move(other.buffer);
+        count = std::exchange(other.count, 0);
+        allocated = std::exchange(other.allocated, 0);
+        sharedCount = std::exchange(other.sharedCount, 0);
+        viewOwner = std::move(other.viewOwner);
+        viewed = std::exchange(other.viewed, nullptr);
+        viewedCount = std::exchange(other.viewedCount, 0);
+        return *this;
+    }
+
+    PodArray& operator=(const PodArray& other) {
+        if (this == &other) return *this;
+        if (other.viewed) {
+            view(other.viewOwner, other.viewed, other.viewedCount);
+        }
+        else {
+            other.sharedCount = std::max(other.sharedCount, other.count);
+            view(other.buffer, other.buffer.get(), other.count);
+        }
+        return *this;
+    }
+
+    // Views `count` elements at `first`; `owner` keeps that memory alive.
+    void view(std::shared_ptr<const void> owner, const T* first, std::size_t count) {
+        clear();
+        viewOwner = std::move(owner);
+        viewed = first;
+        viewedCount = count;
+    }
+    bool isView() const { return viewed != nullptr; }
+
+    std::size_t size() const { return viewed ? viewedCount : count; }
+    bool empty() const { return size() == 0; }
+    const T* data() const { return viewed ? viewed : buffer.get(); }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+    const T& operator[](std::size_t i) const { return data()[i]; }
+    // Heap elements held; a view holds none.
+    std::size_t capacity() const { return viewed ? 0 : allocated; }
+
+    T* mutableData() {
+        detach();
+        prepareWrite(0);
+        return buffer.get();
+    }
+    void push_back(const T& value) {
+        detach();
+        if (count == allocated) {
+            reallocate(std::max<std::size_t>(16, allocated * 2));
+        }
+        else {
+            prepareWrite(count);
+        }
+        buffer[count++] = value;
+    }
+    void pop_back() {
+        detach();
+        --count;
+    }
+    // Moves the last element into `i`'s place: O(1), but the order changes.
+    void swapRemove(std::size_t i) {
+        detach();
+        prepareWrite(i);
+        buffer[i] = buffer[count - 1];
+        --count;
+    }
+    void resize(std::size_t newCount) {
+        detach();
+        if (newCount > allocated) {
+            reallocate(newCount);
+        }
+        else if (newCount > count) {
+            prepareWrite(count);
+        }
+        std::fill(buffer.get() + std::min(count, newCount), buffer.get() + newCount, T{});
+        count = newCount;
+    }
+    void reserve(std::size_t newCapacity) {
+        detach();
+        if (newCapacity > allocated) reallocate(newCapacity);
+    }
+    void clear() {
+        viewOwner.reset();
+        viewed = nullptr;
+        viewedCount = 0;
+        buffer.reset();
+        count = 0;
+        allocated = 0;
+        sharedCount = 0;
+    }
+
+    void detach() {
+        if (!viewed) return;
+        std::shared_ptr<const void> owner = std::move(viewOwner);
+        const T* first = viewed;
+        std::size_t n = viewedCount;
+        viewed = nullptr;
+        viewedCount = 0;
+
+        // Leave room to keep appending without an immediate second copy.
+        allocated = std::max<std::size_t>(16, n + n / 2);
+        buffer.reset(new T[allocated]);
+        std::copy(first, first + n, buffer.get());
+        count = n;
+        sharedCount = 0;
+    }
+
+private:
+    // Called before writing at index `from` and beyond. Copies still see
+    // the first `sharedCount` elements, so those must not change under them.
+    void prepareWrite(std::size_t from) {
+        if (from < sharedCount && buffer.use_count() > 1) reallocate(allocated);
+    }
+
+    void reallocate(std::size_t newCapacity) {
+        std::shared_ptr<T[]> grown(new T[newCapacity]);
+        if (buffer) std::copy(buffer.get(), buffer.get() + count, grown.get());
+        buffer = std::move(grown);
+        allocated = newCapacity;
+        sharedCount = 0;
+    }
+
+    std::shared_ptr<T[]> buffer;
+    std::size_t count = 0;
+    std::size_t allocated = 0;
+    // How many leading elements copies of this array may be reading.
+    mutable std::size_t sharedCount = 0;
+
+    const T* viewed = nullptr;
+    std::size_t viewedCount = 0;
+    std::shared_ptr<const void> viewOwner;
+};
@@ -0,0 +1,97 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+// Weight of the newest frame in the exponential moving average.
+constexpr float AVERAGE_WEIGHT = 0.05f;
+
+float toMs(std::int64_t ns) {
+    return static_cast<float>(ns) / 1.0e6f;
+}
+}
+
+void ZoneRing::push(const ZoneEvent& event) {
+    std::uint64_t index = writeIndex.load(std::memory_order_relaxed);
+    slots[index & (CAPACITY - 1)] = event;
+    writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void ZoneRing::read(std::uint64_t& cursor, std::vector<ZoneEvent>& out) const {
+    std::uint64_t end = writeIndex.load(std::memory_order_acquire);
+    if (end - cursor > CAPACITY) cursor = end - CAPACITY;
+
+    std::size_t first = out.size();
+    std::uint64_t begin = cursor;
+    for (std::uint64_t i = begin; i < end; ++i) {
+        out.push_back(slots[i & (CAPACITY - 1)]);
+    }
+
+    // The writer may have lapped this reader while it was copying. Slot i
+    // is being (or has been) reused once the writer reaches i + CAPACITY,
+    // so drop every copy that may be torn.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::uint64_t after = writeIndex.load(std::memory_order_relaxed);
+    if (after + 1 > begin + CAPACITY) {
+        std::uint64_t lost = std::min(after + 1 - CAPACITY - begin, end - begin);
+        out.erase(out.begin() + first, out.begin() + first + static_cast<std::ptrdiff_t>(lost));
+    }
+    cursor = end;
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+std::int64_t Profiler::now() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::beginFrame() {
+    frameBegin = now();
+    drawCalls = 0;
+    vertexCount = 0;
+}
+
+void Profiler::countDraw(std::size_t vertices) {
+    ++drawCalls;
+    vertexCount += vertices;
+}
+
+void Profiler::pushZone(const char* name, std::uint32_t zoneDepth, std::int64_t beginNs, std::int64_t endNs) {
+    events.push({ name, beginNs, endNs, frame, zoneDepth });
+}
+
+void Profiler::endFrame() {
+    std::int64_t frameEnd = now();
+    pushZone("Frame", 0, frameBegin, frameEnd);
+    lastFrameMs = toMs(frameEnd - frameBegin);
+    frameTimes[frame % FRAME_HISTORY] = lastFrameMs;
+    lastDrawCalls = drawCalls;
+    lastVertexCount = vertexCount;
+
+    for (PhaseStats& phase : phases) {
+        phase.lastMs = 0.0f;
+    }
+
+    drained.clear();
+    events.read(readCursor, drained);
+    for (const ZoneEvent& event : drained) {
+        auto it = std::find_if(phases.begin(), phases.end(),
+            [&event](const PhaseStats& phase) { return std::strcmp(phase.name, event.name) == 0; });
+        if (it == phases.end()) {
+            phases.push_back({ event.name, 0.0f, 0.0f });
+            it = phases.end() - 1;
+        }
+        it->lastMs += toMs(event.endNs - event.beginNs);
+    }
+
+    for (PhaseStats& phase : phases) {
+        phase.averageMs += (phase.lastMs - phase.averageMs) * AVERAGE_WEIGHT;
+    }
+    ++frame;
+}
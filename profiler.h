@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lightweight frame profiler. ProfileZone timers push one record each into
+// a lock-free ring buffer; endFrame() drains it into per-phase statistics.
+// A zone costs two clock reads and one ring write, so it stays compiled in
+// for release builds. Zones must be opened on the main thread.
+
+struct ZoneEvent {
+    const char* name;
+    std::int64_t beginNs;
+    std::int64_t endNs;
+    std::uint32_t frame;
+    std::uint32_t depth;
+};
+
+// Single-producer ring that never blocks the writer. Each reader keeps its
+// own cursor and may run on another thread; records overwritten before a
+// reader gets to them are dropped.
+class ZoneRing {
+public:
+    static constexpr std::size_t CAPACITY = 1 << 14;
+
+    void push(const ZoneEvent& event);
+    // Cursor value that skips everything published so far.
+    std::uint64_t position() const { return writeIndex.load(std::memory_order_acquire); }
+    // Appends everything published since `cursor` to `out` and advances it.
+    void read(std::uint64_t& cursor, std::vector<ZoneEvent>& out) const;
+
+private:
+    std::array<ZoneEvent, CAPACITY> slots{};
+    std::atomic<std::uint64_t> writeIndex{ 0 };
+};
+
+struct PhaseStats {
+    const char* name;
+    float lastMs;
+    float averageMs;
+};
+
+class Profiler {
+public:
+    static constexpr std::size_t FRAME_HISTORY = 240;
+
+    static Profiler& instance();
+    static std::int64_t now();
+
+    void beginFrame();
+    void endFrame();
+    void countDraw(std::size_t vertexCount);
+
+    void pushZone(const char* name, std::uint32_t zoneDepth, std::int64_t beginNs, std::int64_t endNs);
+    std::uint32_t enterZone() { return depth++; }
+    void leaveZone() { --depth; }
+
+    const ZoneRing& ring() const { return events; }
+    std::uint32_t getFrame() const { return frame; }
+
+    const std::vector<PhaseStats>& getPhases() const { return phases; }
+    const float* getFrameTimes() const { return frameTimes.data(); }
+    int getFrameTimeOffset() const { return static_cast<int>(frame % FRAME_HISTORY); }
+    float getLastFrameMs() const { return lastFrameMs; }
+    std::uint32_t getDrawCalls() const { return lastDrawCalls; }
+    std::uint64_t getVertexCount() const { return lastVertexCount; }
+
+private:
+    Profiler() = default;
+
+    ZoneRing events;
+    std::uint64_t readCursor = 0;
+    std::vector<ZoneEvent> drained;
+
+    std::uint32_t frame = 0;
+    std::uint32_t depth = 0;
+    std::int64_t frameBegin = 0;
+    std::uint32_t drawCalls = 0;
+    std::uint64_t vertexCount = 0;
+
+    std::vector<PhaseStats> phases;
+    std::array<float, FRAME_HISTORY> frameTimes{};
+    float lastFrameMs = 0.0f;
+    std::uint32_t lastDrawCalls = 0;
+    std::uint64_t lastVertexCount = 0;
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name)
+        : name(name), depth(Profiler::instance().enterZone()), begin(Profiler::now()) {
+    }
+
+    ~ProfileZone() {
+        Profiler& profiler = Profiler::instance();
+        profiler.leaveZone();
+        profiler.pushZone(name, depth, begin, Profiler::now());
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    std::uint32_t depth;
+    std::int64_t begin;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
@@ -0,0 +1,119 @@
+#include "shape_batch.h"
+#include "shape_renderer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Circles are retained for power-of-two scales, so most zoom steps keep them.
+float circleScaleFor(float scale) {
+    return std::exp2(std::ceil(std::log2(std::max(scale, 1.0f / 1024.0f))));
+}
+}
+
+ShapeBatch::ShapeBatch()
+    : buffer(sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Static),
+      useBuffer(sf::VertexBuffer::isAvailable()) {
+}
+
+void ShapeBatch::erase(std::uint32_t slot) {
+    std::uint32_t entry = entryOf(slot);
+    if (entry == NONE) return;
+    slotEntries[slot] = NONE;
+    // Ranges are only drawn for runs of live entries, so the vertices can
+    // stay where they are.
+    holeVertices += offsets[entry + 1] - offsets[entry];
+}
+
+void ShapeBatch::clear(std::size_t capacity) {
+    offsets.assign(1, 0);
+    slotEntries.clear();
+    holeVertices = 0;
+    // Reallocation discards the contents, which are not needed any more.
+    if (useBuffer && capacity > getCapacity() && !buffer.create(capacity)) useBuffer = false;
+}
+
+std::size_t ShapeBatch::bytesUsed() const {
+    return offsets.capacity() * sizeof(std::uint32_t) + slotEntries.capacity() * sizeof(std::uint32_t);
+}
+
+void ShapeBatch::drawRange(sf::RenderTarget& target, std::size_t first, std::size_t count,
+    const sf::RenderStates& states) const {
+    if (count == 0) return;
+
+    std::size_t firstVertex = offsets[first];
+    std::size_t vertexCount = offsets[first + count] - firstVertex;
+    if (vertexCount == 0) return;
+    Profiler::instance().countDraw(vertexCount);
+    target.draw(buffer, firstVertex, vertexCount, states);
+}
+
+// Opens entry size() for the shape in `slot`; its vertices follow.
+void ShapeBatch::beginEntry(std::uint32_t slot) {
+    if (slot >= slotEntries.size()) slotEntries.resize(slot + 1, NONE);
+    slotEntries[slot] = static_cast<std::uint32_t>(size());
+}
+
+// Sends the staged vertices to the GPU at `firstVertex` and moves past them.
+bool ShapeBatch::upload(std::size_t& firstVertex, std::vector<sf::Vertex>& staging) {
+    if (!useBuffer) return false;
+    if (staging.empty()) return true;
+    if (firstVertex + staging.size() > getCapacity()) return false;
+    if (!buffer.update(staging.data(), staging.size(), static_cast<unsigned int>(firstVertex))) {
+        useBuffer = false;
+        return false;
+    }
+    firstVertex += staging.size();
+    staging.clear();
+    return true;
+}
+
+void ShapeBatches::fill(const Document& document, const std::vector<ShapeHandle>& shapes, float scale) {
+    float wanted = circleScaleFor(scale);
+    if (wanted != circleScale) {
+        circleScale = wanted;
+        batchOf(ShapeKind::Circle).clear();
+    }
+    for (std::size_t k = 0; k < SHAPE_KIND_COUNT; ++k) fill(document, shapes, static_cast<ShapeKind>(k));
+}
+
+void ShapeBatches::erase(ShapeHandle shape) {
+    ShapeBatch& batch = batchOf(shape.kind);
+    batch.erase(shape.slot);
+    if (batch.needsCompaction()) batch.clear();
+}
+
+void ShapeBatches::clear() {
+    for (ShapeBatch& batch : batches) batch.clear();
+}
+
+std::size_t ShapeBatches::bytesUsed() const {
+    std::size_t bytes = missing.capacity() * sizeof(ShapeHandle) + staging.capacity() * sizeof(sf::Vertex);
+    for (const ShapeBatch& batch : batches) bytes += batch.bytesUsed();
+    return bytes;
+}
+
+std::size_t ShapeBatches::gpuBytesUsed() const {
+    std::size_t bytes = 0;
+    for (const ShapeBatch& batch : batches) bytes += batch.getCapacity() * sizeof(sf::Vertex);
+    return bytes;
+}
+
+void ShapeBatches::fill(const Document& document, const std::vector<ShapeHandle>& shapes, ShapeKind kind) {
+    ShapeBatch& batch = batchOf(kind);
+    while (batch.isAvailable()) {
+        missing.clear();
+        for (ShapeHandle shape : shapes) {
+            if (shape.kind == kind && batch.entryOf(shape.slot) == ShapeBatch::NONE) missing.push_back(shape);
+        }
+        bool appended = batch.append(missing, staging, [&](std::size_t i, std::vector<sf::Vertex>& out) {
+            tessellateShape(document, *document.find(missing[i]), circleScale, out);
+        });
+        if (appended) return;
+
+        // Out of room. Shapes dropped here come back when they are drawn
+        // again; the buffer only grows if compacting would not free enough.
+        batch.clear(batch.needsCompaction() ? 0 : batch.getCapacity() * 2);
+    }
+}
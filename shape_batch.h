@@ -0,0 +1,119 @@
+#pragma once
+
+#include "document.h"
+#include "shapes.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keeps the triangles of many shapes of one kind in a single vertex buffer
+// so any run of them is drawn with one call. The triangles live only on
+// the GPU: they are tessellated into a bounded staging array, uploaded into
+// the next free part of the buffer and never read back.
+//
+// Shapes are appended as entries, in order, and looked up by their slot in
+// the document (see SlotMap). Erasing a shape only forgets its entry; the
+// holes are reclaimed by clearing the batch once they are half of it, and
+// the shapes still shown are appended again the next time they are drawn.
+class ShapeBatch {
+public:
+    static constexpr std::uint32_t NONE = 0xFFFFFFFFu;
+    // Size of the staging array. Triangles are uploaded once it is half
+    // full, which leaves room for the largest shape without growing it.
+    static constexpr std::size_t STAGING_VERTICES = 1 << 16;
+
+    ShapeBatch();
+
+    // False if vertex buffers are unsupported or failed; the batch then
+    // holds nothing and the shapes have to be drawn some other way.
+    bool isAvailable() const { return useBuffer; }
+
+    // Adds `shapes`, none of which may hold an entry yet; tessellate(i, out)
+    // appends the triangles of shapes[i] to `out`. Returns false if the
+    // buffer ran out of room, in which case the batch must be cleared.
+    template <typename Tessellate>
+    bool append(const std::vector<ShapeHandle>& shapes, std::vector<sf::Vertex>& staging, Tessellate&& tessellate);
+    void erase(std::uint32_t slot);
+    // Drops every entry. The buffer is reallocated if it holds fewer than
+    // `capacity` vertices.
+    void clear(std::size_t capacity = 0);
+    // Whether enough of the batch is erased shapes that it should be cleared.
+    bool needsCompaction() const { return holeVertices > getVertexCount() / 2; }
+    // Entry of the shape in `slot`, or NONE.
+    std::uint32_t entryOf(std::uint32_t slot) const { return slot < slotEntries.size() ? slotEntries[slot] : NONE; }
+    // Number of entries, erased ones included.
+    std::size_t size() const { return offsets.size() - 1; }
+    std::size_t getVertexCount() const { return offsets.back(); }
+    std::size_t getCapacity() const { return buffer.getVertexCount(); }
+    // Bookkeeping in system memory; the triangles themselves are on the GPU.
+    std::size_t bytesUsed() const;
+
+    // Draws entries [first, first + count) with one call.
+    void drawRange(sf::RenderTarget& target, std::size_t first, std::size_t count,
+        const sf::RenderStates& states = sf::RenderStates::Default) const;
+
+private:
+    void beginEntry(std::uint32_t slot);
+    bool upload(std::size_t& firstVertex, std::vector<sf::Vertex>& staging);
+
+    // Entry i owns vertices [offsets[i], offsets[i + 1]).
+    std::vector<std::uint32_t> offsets{ 0 };
+    // Entry of each slot, or NONE.
+    std::vector<std::uint32_t> slotEntries;
+    // Vertices of erased entries.
+    std::size_t holeVertices = 0;
+    sf::VertexBuffer buffer;
+    bool useBuffer = false;
+};
+
+template <typename Tessellate>
+bool ShapeBatch::append(const std::vector<ShapeHandle>& shapes, std::vector<sf::Vertex>& staging,
+    Tessellate&& tessellate) {
+    if (shapes.empty()) return true;
+    if (getCapacity() == 0) clear(STAGING_VERTICES);
+
+    std::size_t stagedFrom = getVertexCount();
+    staging.clear();
+    staging.reserve(STAGING_VERTICES);
+    for (std::size_t i = 0; i < shapes.size(); ++i) {
+        beginEntry(shapes[i].slot);
+        tessellate(i, staging);
+        offsets.push_back(static_cast<std::uint32_t>(stagedFrom + staging.size()));
+        if (staging.size() >= STAGING_VERTICES / 2 && !upload(stagedFrom, staging)) return false;
+    }
+    return upload(stagedFrom, staging);
+}
+
+// One ShapeBatch per kind, for the app to keep in step with its edits. The
+// batches start out empty and are filled with the shapes that actually get
+// drawn, so loading a document tessellates nothing up front and shapes
+// that are never shown never take GPU memory.
+class ShapeBatches {
+public:
+    const ShapeBatch& of(ShapeKind kind) const { return batches[static_cast<std::size_t>(kind)]; }
+
+    // Appends the shapes in `shapes` that are not retained yet. Circles are
+    // tessellated for getCircleScale(), which follows `scale` (screen
+    // pixels per world unit) rounded up to a power of two; moving to
+    // another power drops the retained circles.
+    void fill(const Document& document, const std::vector<ShapeHandle>& shapes, float scale);
+    float getCircleScale() const { return circleScale; }
+    // Call after the document erased `shape`.
+    void erase(ShapeHandle shape);
+    // Drops every retained shape, for a document that was replaced.
+    void clear();
+    std::size_t bytesUsed() const;
+    std::size_t gpuBytesUsed() const;
+
+private:
+    void fill(const Document& document, const std::vector<ShapeHandle>& shapes, ShapeKind kind);
+    ShapeBatch& batchOf(ShapeKind kind) { return batches[static_cast<std::size_t>(kind)]; }
+
+    ShapeBatch batches[SHAPE_KIND_COUNT];
+    float circleScale = 1.0f;
+    std::vector<ShapeHandle> missing;
+    std::vector<sf::Vertex> staging;
+};
@@ -0,0 +1,177 @@
+#include "shape_renderer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float PI = 3.14159265358979f;
+
+void appendTriangle(std::vector<sf::Vertex>& out, sf::Vector2f a, sf::Vector2f b, sf::Vector2f c, sf::Color color) {
+    out.push_back({ a, color, {} });
+    out.push_back({ b, color, {} });
+    out.push_back({ c, color, {} });
+}
+
+void appendQuad(std::vector<sf::Vertex>& out, sf::Vector2f a, sf::Vector2f b, sf::Vector2f c, sf::Vector2f d, sf::Color color) {
+    appendTriangle(out, a, b, c, color);
+    appendTriangle(out, a, c, d, color);
+}
+
+// Half disc of the given radius centred on `center`, bulging towards `out`.
+void appendCap(std::vector<sf::Vertex>& vertices, sf::Vector2f center, sf::Vector2f side, sf::Vector2f out,
+    float radius, std::size_t segments, sf::Color color) {
+    sf::Vector2f previous = center + side * radius;
+    for (std::size_t k = 1; k <= segments; ++k) {
+        float angle = PI * static_cast<float>(k) / static_cast<float>(segments);
+        sf::Vector2f next = center + (side * std::cos(angle) + out * std::sin(angle)) * radius;
+        vertices.push_back({ center, color, {} });
+        vertices.push_back({ previous, color, {} });
+        vertices.push_back({ next, color, {} });
+        previous = next;
+    }
+}
+
+// Closed ring between matching inner and outer outlines.
+void appendRing(std::vector<sf::Vertex>& out, const sf::Vector2f* inner, const sf::Vector2f* outer,
+    std::size_t count, sf::Color color) {
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t j = (i + 1) % count;
+        appendQuad(out, inner[i], outer[i], outer[j], inner[j], color);
+    }
+}
+}
+
+void tessellateLine(const Line& line, std::vector<sf::Vertex>& out) {
+    float half = std::max(line.thickness, 1.0f) / 2.0f;
+    sf::Vector2f delta = line.end - line.start;
+    float length = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+    sf::Vector2f dir = length > 0.0f ? delta / length : sf::Vector2f(1.0f, 0.0f);
+    sf::Vector2f normal(-dir.y, dir.x);
+    sf::Vector2f offset = normal * half;
+
+    out.push_back({ line.start + offset, line.firstColor, {} });
+    out.push_back({ line.end + offset, line.secondColor, {} });
+    out.push_back({ line.end - offset, line.secondColor, {} });
+    out.push_back({ line.start + offset, line.firstColor, {} });
+    out.push_back({ line.end - offset, line.secondColor, {} });
+    out.push_back({ line.start - offset, line.firstColor, {} });
+
+    // Caps are tessellated at world scale so the cached geometry does not
+    // depend on the zoom.
+    std::size_t segments = std::max<std::size_t>(2, circlePointCount(half) / 2);
+    appendCap(out, line.start, normal, -dir, half, segments, line.firstColor);
+    appendCap(out, line.end, -normal, dir, half, segments, line.secondColor);
+}
+
+void tessellateRectangle(const RectangleStore& rectangles, std::size_t i, std::vector<sf::Vertex>& out) {
+    sf::Vector2f p = rectangles.position[i];
+    sf::Vector2f s = rectangles.size[i];
+    float t = rectangles.outlineThickness[i];
+
+    sf::Vector2f inner[4] = { p, { p.x + s.x, p.y }, p + s, { p.x, p.y + s.y } };
+    sf::Vector2f outer[4] = {
+        { p.x - t, p.y - t }, { p.x + s.x + t, p.y - t }, { p.x + s.x + t, p.y + s.y + t }, { p.x - t, p.y + s.y + t }
+    };
+
+    if (rectangles.fillColor[i].a != 0) {
+        appendQuad(out, inner[0], inner[1], inner[2], inner[3], rectangles.fillColor[i]);
+    }
+    if (t != 0.0f) {
+        appendRing(out, inner, outer, 4, rectangles.outlineColor[i]);
+    }
+}
+
+std::size_t circlePointCount(float screenRadius) {
+    // A chord spanning angle a deviates from the arc by r * (1 - cos(a / 2)).
+    if (screenRadius <= CIRCLE_TOLERANCE) return MIN_CIRCLE_POINTS;
+    float step = 2.0f * std::acos(1.0f - CIRCLE_TOLERANCE / screenRadius);
+    auto count = static_cast<std::size_t>(std::ceil(2.0f * PI / step));
+    return std::clamp(count, MIN_CIRCLE_POINTS, MAX_CIRCLE_POINTS);
+}
+
+void tessellateCircle(const CircleStore& circles, std::size_t i, float scale, std::vector<sf::Vertex>& out) {
+    sf::Vector2f c = circles.center[i];
+    float r = circles.radius[i];
+    float t = circles.outlineThickness[i];
+    if (t == 0.0f) return;
+
+    std::size_t count = circlePointCount((r + t) * scale);
+    sf::Vector2f inner[MAX_CIRCLE_POINTS];
+    sf::Vector2f outer[MAX_CIRCLE_POINTS];
+    for (std::size_t k = 0; k < count; ++k) {
+        float angle = static_cast<float>(k) * 2.0f * PI / static_cast<float>(count) - PI / 2.0f;
+        sf::Vector2f dir(std::cos(angle), std::sin(angle));
+        inner[k] = c + dir * r;
+        outer[k] = c + dir * (r + t);
+    }
+    appendRing(out, inner, outer, count, circles.outlineColor[i]);
+}
+
+void tessellateShape(const Document& document, ShapeRef shape, float scale, std::vector<sf::Vertex>& out) {
+    switch (shape.kind) {
+    case ShapeKind::Line:
+        tessellateLine(document.lines[shape.index], out);
+        break;
+    case ShapeKind::Rectangle:
+        tessellateRectangle(document.rectangles, shape.index, out);
+        break;
+    case ShapeKind::Circle:
+        tessellateCircle(document.circles, shape.index, scale, out);
+        break;
+    }
+}
+
+void ShapeRenderer::draw(sf::RenderTarget& target, const Document& document, ShapeBatches& batches,
+    const std::vector<ShapeHandle>& shapes, const sf::RenderStates& states) {
+    batches.fill(document, shapes, scale);
+    // Circles look the same whether they come from the batch or not.
+    float circleScale = batches.getCircleScale();
+    scratch.clear();
+
+    for (std::size_t i = 0; i < shapes.size();) {
+        ShapeHandle shape = shapes[i];
+        // Shapes of one kind with consecutive entries are one range of
+        // their batch.
+        const ShapeBatch& batch = batches.of(shape.kind);
+        std::uint32_t first = batch.entryOf(shape.slot);
+        std::size_t run = 1;
+        while (first != ShapeBatch::NONE && i + run < shapes.size() && shapes[i + run].kind == shape.kind &&
+            batch.entryOf(shapes[i + run].slot) == first + run) {
+            ++run;
+        }
+        if (first != ShapeBatch::NONE && run >= MIN_BUFFERED_RUN) {
+            flush(target, states);
+            batch.drawRange(target, first, run, states);
+        }
+        else {
+            for (std::size_t k = i; k < i + run; ++k) {
+                tessellateShape(document, *document.find(shapes[k]), circleScale, scratch);
+            }
+        }
+        i += run;
+        if (scratch.size() >= CHUNK_VERTICES) flush(target, states);
+    }
+
+    flush(target, states);
+}
+
+void ShapeRenderer::drawRectangle(sf::RenderTarget& target, const RectangleStore& rectangles, std::size_t i) {
+    scratch.clear();
+    tessellateRectangle(rectangles, i, scratch);
+    flush(target, sf::RenderStates::Default);
+}
+
+void ShapeRenderer::drawCircle(sf::RenderTarget& target, const CircleStore& circles, std::size_t i) {
+    scratch.clear();
+    tessellateCircle(circles, i, scale, scratch);
+    flush(target, sf::RenderStates::Default);
+}
+
+void ShapeRenderer::flush(sf::RenderTarget& target, const sf::RenderStates& states) {
+    if (!scratch.empty()) {
+        Profiler::instance().countDraw(scratch.size());
+        target.draw(scratch.data(), scratch.size(), sf::PrimitiveType::Triangles, states);
+    }
+    scratch.clear();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "document.h"
+#include "shape_batch.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstddef>
+#include <vector>
+
+constexpr std::size_t MIN_CIRCLE_POINTS = 6;
+constexpr std::size_t MAX_CIRCLE_POINTS = 512;
+// Largest allowed gap, in screen pixels, between the true circle and its polygon.
+constexpr float CIRCLE_TOLERANCE = 0.25f;
+
+// Number of polygon points needed for a circle of the given on-screen radius.
+std::size_t circlePointCount(float screenRadius);
+
+// Append the triangles of a stroked line: a quad `thickness` wide with
+// round caps. Colours run from firstColor at the start to secondColor at
+// the end, so gradients survive the tessellation.
+void tessellateLine(const Line& line, std::vector<sf::Vertex>& out);
+
+// Append the triangles of one shape (fill, then outline ring) to `out`.
+// The outline grows outwards from the shape edge like sf::Shape's does.
+// Circles are tessellated for `scale` screen pixels per world unit.
+void tessellateRectangle(const RectangleStore& rectangles, std::size_t i, std::vector<sf::Vertex>& out);
+void tessellateCircle(const CircleStore& circles, std::size_t i, float scale, std::vector<sf::Vertex>& out);
+// Any of the above for a shape of the document.
+void tessellateShape(const Document& document, ShapeRef shape, float scale, std::vector<sf::Vertex>& out);
+
+// Draws the document's shapes in draw order from their retained triangles
+// (see ShapeBatches), retaining the ones drawn for the first time. A long
+// run of shapes of one kind that are also consecutive in their batch is
+// drawn straight from its GPU buffer, so a document drawn in the order it
+// was made takes a handful of calls. Shorter runs are tessellated again
+// into one shared scratch array, as is everything when vertex buffers are
+// unavailable. That array is flushed in large chunks, so memory stays
+// bounded and interleaved kinds still share draw calls.
+class ShapeRenderer {
+public:
+    static constexpr std::size_t CHUNK_VERTICES = 1 << 16;
+    // Shorter runs are cheaper to tessellate again than to draw separately.
+    static constexpr std::size_t MIN_BUFFERED_RUN = 32;
+
+    // Screen pixels per world unit of the target being drawn to; picks the
+    // circle level of detail.
+    void setScale(float pixelsPerUnit) { scale = pixelsPerUnit; }
+
+    // Draws `shapes`, which must all exist, in the given order, normally
+    // sorted bottom to top (see Document::sortByDepth()). `batches` must
+    // be kept in step with the document's erases.
+    void draw(sf::RenderTarget& target, const Document& document, ShapeBatches& batches,
+        const std::vector<ShapeHandle>& shapes, const sf::RenderStates& states = sf::RenderStates::Default);
+    void drawRectangle(sf::RenderTarget& target, const RectangleStore& rectangles, std::size_t i);
+    void drawCircle(sf::RenderTarget& target, const CircleStore& circles, std::size_t i);
+
+private:
+    void flush(sf::RenderTarget& target, const sf::RenderStates& states);
+
+    std::vector<sf::Vertex> scratch;
+    float scale = 1.0f;
+};
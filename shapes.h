@@ -0,0 +1,92 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <variant>
+
+struct Line {
+    sf::Vector2f start;
+    sf::Vector2f end;
+    sf::Color firstColor;
+    sf::Color secondColor;
+    float thickness = 1.0f;
+};
+
+// Rectangles and circles by value, for passing a single shape around. The
+// document itself stores them field by field (see document.h).
+struct RectangleData {
+    sf::Vector2f position;
+    sf::Vector2f size;
+    sf::Color fillColor;
+    sf::Color outlineColor;
+    float outlineThickness = 1.0f;
+};
+
+struct CircleData {
+    sf::Vector2f center;
+    float radius = 0.0f;
+    sf::Color outlineColor;
+    float outlineThickness = 1.0f;
+};
+
+inline sf::FloatRect lineBounds(const Line& line) {
+    float padding = std::max(line.thickness, 1.0f) / 2.0f + 1.0f;
+    sf::Vector2f min(std::min(line.start.x, line.end.x), std::min(line.start.y, line.end.y));
+    sf::Vector2f max(std::max(line.start.x, line.end.x), std::max(line.start.y, line.end.y));
+    return sf::FloatRect(min - sf::Vector2f(padding, padding), max - min + sf::Vector2f(2 * padding, 2 * padding));
+}
+
+inline bool intersects(const sf::FloatRect& a, const sf::FloatRect& b) {
+    return a.position.x <= b.position.x + b.size.x && b.position.x <= a.position.x + a.size.x &&
+        a.position.y <= b.position.y + b.size.y && b.position.y <= a.position.y + a.size.y;
+}
+
+enum class ShapeKind : std::uint8_t {
+    Line,
+    Rectangle,
+    Circle
+};
+
+constexpr std::size_t SHAPE_KIND_COUNT = 3;
+
+// A single shape by value; the alternatives follow the ShapeKind order.
+using ShapeData = std::variant<Line, RectangleData, CircleData>;
+
+inline ShapeKind shapeKind(const ShapeData& shape) {
+    return static_cast<ShapeKind>(shape.index());
+}
+
+// A committed shape's current position in its kind's storage. Positions
+// change when other shapes are erased; use a ShapeHandle to hold on to a
+// shape.
+struct ShapeRef {
+    ShapeKind kind;
+    std::uint32_t index;
+};
+
+inline bool operator==(ShapeRef a, ShapeRef b) {
+    return a.kind == b.kind && a.index == b.index;
+}
+
+inline bool operator<(ShapeRef a, ShapeRef b) {
+    return a.kind != b.kind ? a.kind < b.kind : a.index < b.index;
+}
+
+// Stable identity of a committed shape (see SlotMap). A handle stays valid
+// for as long as its shape exists. Erasing a shape bumps its slot's
+// generation, so a new shape reusing the slot gets a different handle and a
+// stale one cannot reach it. Undoing the erase is the one exception, on
+// purpose: the shape comes back under its original handle, so the undo
+// history and anything else still holding it keep working.
+struct ShapeHandle {
+    ShapeKind kind;
+    std::uint32_t slot;
+    std::uint32_t generation;
+};
+
+inline bool operator==(ShapeHandle a, ShapeHandle b) {
+    return a.kind == b.kind && a.slot == b.slot && a.generation == b.generation;
+}
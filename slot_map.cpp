@@ -0,0 +1,85 @@
+#include "slot_map.h"
+
+std::optional<std::uint32_t> SlotMap::find(std::uint32_t slot, std::uint32_t generation, std::size_t count) const {
+    if (entries.empty()) {
+        if (generation != 0 || slot >= count) return std::nullopt;
+        return slot;
+    }
+    if (slot >= entries.size() || entries[slot].generation != generation || entries[slot].index == NONE) {
+        return std::nullopt;
+    }
+    return entries[slot].index;
+}
+
+std::uint32_t SlotMap::insert(std::size_t count) {
+    materialize(count - 1);
+
+    std::uint32_t slot = static_cast<std::uint32_t>(entries.size());
+    while (!freeSlots.empty()) {
+        std::uint32_t candidate = freeSlots[freeSlots.size() - 1];
+        freeSlots.pop_back();
+        if (entries[candidate].index == NONE) {
+            slot = candidate;
+            break;
+        }
+    }
+    if (slot == entries.size()) entries.push_back({ NONE, 0 });
+
+    entry(slot).index = static_cast<std::uint32_t>(count - 1);
+    slots.push_back(slot);
+    return slot;
+}
+
+void SlotMap::insertAt(std::uint32_t slot, std::uint32_t generation, std::size_t count) {
+    materialize(count - 1);
+
+    while (entries.size() <= slot) {
+        freeSlots.push_back(static_cast<std::uint32_t>(entries.size()));
+        entries.push_back({ NONE, 0 });
+    }
+    entry(slot) = { static_cast<std::uint32_t>(count - 1), generation };
+    slots.push_back(slot);
+    // Usually the slot was just freed by undoing the shape; stop listing it.
+    if (!freeSlots.empty() && freeSlots[freeSlots.size() - 1] == slot) freeSlots.pop_back();
+}
+
+void SlotMap::erase(std::uint32_t index, std::size_t count) {
+    materialize(count);
+
+    std::uint32_t last = static_cast<std::uint32_t>(count - 1);
+    std::uint32_t slot = slots[index];
+    std::uint32_t movedSlot = slots[last];
+    slots.mutableData()[index] = movedSlot;
+    slots.pop_back();
+    entry(movedSlot).index = index;
+
+    Entry& erased = entry(slot);
+    erased.index = NONE;
+    ++erased.generation;
+    freeSlots.push_back(slot);
+}
+
+void SlotMap::clear() {
+    slots.clear();
+    entries.clear();
+    freeSlots.clear();
+}
+
+std::size_t SlotMap::bytesUsed() const {
+    return slots.capacity() * sizeof(std::uint32_t) + entries.capacity() * sizeof(Entry) +
+        freeSlots.capacity() * sizeof(std::uint32_t);
+}
+
+// Builds the identity mapping a loaded document starts out with.
+void SlotMap::materialize(std::size_t count) {
+    if (!entries.empty() || count == 0) return;
+
+    slots.resize(count);
+    entries.resize(count);
+    std::uint32_t* slot = slots.mutableData();
+    Entry* entry = entries.mutableData();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        slot[i] = i;
+        entry[i] = { i, 0 };
+    }
+}
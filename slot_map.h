@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pod_array.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Stable slots for the shapes of one kind, whose fields live in dense
+// arrays that are compacted by swapping the last shape into an erased
+// one's place. Each slot records where its shape currently is, and each
+// shape its slot, so lookups, inserts and erases are all O(1) and the
+// dense arrays never have holes to skip while drawing.
+//
+// A freshly loaded document has no slot arrays at all: slot i is shape i,
+// generation 0. The arrays are built on the first insert or erase, so
+// documents that are only read never pay for them.
+class SlotMap {
+public:
+    static constexpr std::uint32_t NONE = 0xFFFFFFFFu;
+
+    // Where the shape in `slot` is, if `generation` is still current.
+    // `count` is the number of shapes, needed while no arrays exist.
+    std::optional<std::uint32_t> find(std::uint32_t slot, std::uint32_t generation, std::size_t count) const;
+    std::uint32_t slotAt(std::uint32_t index) const { return slots.empty() ? index : slots[index]; }
+    std::uint32_t generationOf(std::uint32_t slot) const { return entries.empty() ? 0 : entries[slot].generation; }
+
+    // Gives the shape just appended at index `count - 1` a free slot.
+    std::uint32_t insert(std::size_t count);
+    // Same, but in a given slot and generation, which must not be in use:
+    // brings an erased shape back under its old handle.
+    void insertAt(std::uint32_t slot, std::uint32_t generation, std::size_t count);
+    // The shape at `index` is erased; the last shape (index `count - 1`)
+    // takes its place.
+    void erase(std::uint32_t index, std::size_t count);
+
+    void clear();
+    std::size_t bytesUsed() const;
+
+private:
+    struct Entry {
+        // Shape index, or NONE while the slot is free.
+        std::uint32_t index;
+        std::uint32_t generation;
+    };
+
+    void materialize(std::size_t count);
+    Entry& entry(std::uint32_t slot) { return entries.mutableData()[slot]; }
+
+    // Slot of each shape, by index.
+    PodArray<std::uint32_t> slots;
+    PodArray<Entry> entries;
+    // Free slots, most recently freed last. insertAt() may claim a slot that
+    // is still listed here; insert() skips those.
+    PodArray<std::uint32_t> freeSlots;
+};
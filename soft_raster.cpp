@@ -0,0 +1,233 @@
+#include "soft_raster.h"
+#include "shape_renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+struct Point {
+    float x, y;
+    float r, g, b, a;
+};
+
+std::uint8_t blendChannel(unsigned int src, unsigned int dst, unsigned int alpha) {
+    return static_cast<std::uint8_t>((src * alpha + dst * (255 - alpha) + 127) / 255);
+}
+
+// The span loops below are kept branch-free over plain bytes so the compiler
+// can vectorize them.
+void fillSpan(std::uint8_t* pixels, int count, sf::Color color) {
+    if (color.a == 255) {
+        std::uint32_t packed;
+        std::uint8_t bytes[4] = { color.r, color.g, color.b, color.a };
+        std::memcpy(&packed, bytes, 4);
+        // memcpy rather than a uint32_t store keeps this legal under strict
+        // aliasing; it still compiles to plain word stores.
+        for (int i = 0; i < count; ++i) std::memcpy(pixels + i * 4, &packed, 4);
+        return;
+    }
+    if (color.a == 0) return;
+
+    // sf::BlendAlpha: colour uses (srcAlpha, 1 - srcAlpha), alpha uses (1, 1 - srcAlpha).
+    unsigned int a = color.a;
+    for (int i = 0; i < count; ++i) {
+        std::uint8_t* p = pixels + i * 4;
+        p[0] = blendChannel(color.r, p[0], a);
+        p[1] = blendChannel(color.g, p[1], a);
+        p[2] = blendChannel(color.b, p[2], a);
+        p[3] = blendChannel(255, p[3], a);
+    }
+}
+
+void fillGradientSpan(std::uint8_t* pixels, int count, const Point& start, const Point& step) {
+    for (int i = 0; i < count; ++i) {
+        float t = static_cast<float>(i);
+        auto a = static_cast<unsigned int>(start.a + step.a * t + 0.5f);
+        std::uint8_t* p = pixels + i * 4;
+        p[0] = blendChannel(static_cast<unsigned int>(start.r + step.r * t + 0.5f), p[0], a);
+        p[1] = blendChannel(static_cast<unsigned int>(start.g + step.g * t + 0.5f), p[1], a);
+        p[2] = blendChannel(static_cast<unsigned int>(start.b + step.b * t + 0.5f), p[2], a);
+        p[3] = blendChannel(255, p[3], a);
+    }
+}
+
+Point lerp(const Point& from, const Point& to, float t) {
+    return { from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t, from.r + (to.r - from.r) * t,
+        from.g + (to.g - from.g) * t, from.b + (to.b - from.b) * t, from.a + (to.a - from.a) * t };
+}
+
+// Point on the edge from `upper` to `lower` at height y. Callers always pass
+// the endpoints in the same order, so triangles sharing an edge agree on it
+// exactly and no pixel is covered twice.
+Point edgeAt(const Point& upper, const Point& lower, float y) {
+    return lerp(upper, lower, (y - upper.y) / (lower.y - upper.y));
+}
+
+float edgeX(const Point& upper, const Point& lower, float y) {
+    return upper.x + (lower.x - upper.x) * ((y - upper.y) / (lower.y - upper.y));
+}
+
+// First pixel whose centre is at or past `v`, clamped to [low, high] while
+// still a float so far-off or NaN coordinates never reach the cast.
+int pixelAt(float v, int low, int high) {
+    float pixel = std::ceil(v - 0.5f);
+    if (!(pixel > static_cast<float>(low))) return low;
+    if (pixel >= static_cast<float>(high)) return high;
+    return static_cast<int>(pixel);
+}
+
+bool isFinite(const Point& p) {
+    return std::isfinite(p.x) && std::isfinite(p.y);
+}
+
+bool above(const Point& a, const Point& b) {
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+// Fills the pixels whose centres fall inside the triangle, restricted to
+// rows [top, bottom).
+void rasterizeTriangle(RasterImage& image, Point v0, Point v1, Point v2, int top, int bottom, bool flat,
+    sf::Color color) {
+    if (!isFinite(v0) || !isFinite(v1) || !isFinite(v2)) return;
+    if (above(v1, v0)) std::swap(v0, v1);
+    if (above(v2, v1)) std::swap(v1, v2);
+    if (above(v1, v0)) std::swap(v0, v1);
+    if (v0.y == v2.y) return;
+
+    int firstRow = pixelAt(v0.y, top, bottom);
+    int lastRow = pixelAt(v2.y, top, bottom);
+    int width = static_cast<int>(image.width);
+
+    for (int y = firstRow; y < lastRow; ++y) {
+        float center = static_cast<float>(y) + 0.5f;
+        if (flat) {
+            float left = edgeX(v0, v2, center);
+            float right = center < v1.y ? edgeX(v0, v1, center) : edgeX(v1, v2, center);
+            if (right < left) std::swap(left, right);
+            int x0 = pixelAt(left, 0, width);
+            int x1 = pixelAt(right, 0, width);
+            if (x1 > x0) fillSpan(image.row(static_cast<unsigned int>(y)) + static_cast<std::size_t>(x0) * 4, x1 - x0, color);
+            continue;
+        }
+
+        Point left = edgeAt(v0, v2, center);
+        Point right = center < v1.y ? edgeAt(v0, v1, center) : edgeAt(v1, v2, center);
+        if (right.x < left.x) std::swap(left, right);
+
+        int x0 = pixelAt(left.x, 0, width);
+        int x1 = pixelAt(right.x, 0, width);
+        if (x1 <= x0) continue;
+
+        float span = right.x - left.x;
+        float inv = span > 0.0f ? 1.0f / span : 0.0f;
+        Point step{ 0, 0, (right.r - left.r) * inv, (right.g - left.g) * inv, (right.b - left.b) * inv,
+            (right.a - left.a) * inv };
+        Point start = lerp(left, right, (static_cast<float>(x0) + 0.5f - left.x) * inv);
+        fillGradientSpan(image.row(static_cast<unsigned int>(y)) + static_cast<std::size_t>(x0) * 4, x1 - x0, start, step);
+    }
+}
+}
+
+void RasterImage::resize(unsigned int newWidth, unsigned int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    pixels.assign(static_cast<std::size_t>(width) * height * 4, 0);
+}
+
+void SoftRasterizer::render(const Document& document, const sf::FloatRect& area, RasterImage& image,
+    sf::Color background) {
+    if (image.width == 0 || image.height == 0 || area.size.x <= 0.0f || area.size.y <= 0.0f) return;
+
+    origin = area.position;
+    scale = sf::Vector2f(image.width / area.size.x, image.height / area.size.y);
+    binShapes(document, area, image);
+
+    unsigned int threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned int>(threads, static_cast<unsigned int>(bands.size()));
+
+    // Bands are handed out one at a time so a thread that drew an empty band
+    // picks up more work instead of idling.
+    std::atomic<std::size_t> nextBand{ 0 };
+    auto worker = [&]() {
+        std::vector<sf::Vertex> scratch;
+        for (std::size_t band; (band = nextBand.fetch_add(1)) < bands.size();) {
+            renderBand(document, band, image, background, scratch);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool) thread.join();
+}
+
+void SoftRasterizer::binShapes(const Document& document, const sf::FloatRect& area, const RasterImage& image) {
+    std::size_t bandCount = (image.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    bands.resize(bandCount);
+    for (Band& band : bands) band.shapes.clear();
+    if (bandCount == 0) return;
+
+    auto bin = [&](ShapeRef shape) {
+        sf::FloatRect bounds = document.bounds(shape);
+        if (!intersects(bounds, area)) return;
+        float top = (bounds.position.y - origin.y) * scale.y;
+        float bottom = (bounds.position.y + bounds.size.y - origin.y) * scale.y;
+        // Clamped while still floats: casting a negative or out-of-range
+        // float to size_t is undefined.
+        float lastBand = static_cast<float>(bandCount - 1);
+        auto first = static_cast<std::size_t>(std::clamp(top / BAND_HEIGHT, 0.0f, lastBand));
+        auto last = static_cast<std::size_t>(std::clamp(bottom / BAND_HEIGHT, 0.0f, lastBand));
+        for (std::size_t i = first; i <= last; ++i) bands[i].shapes.push_back(shape);
+    };
+
+    // Binned bottom to top, so every band is drawn in the document's order.
+    std::vector<ShapeRef> shapes;
+    shapes.reserve(document.shapeCount());
+    for (std::uint32_t i = 0; i < document.lines.size(); ++i) shapes.push_back({ ShapeKind::Line, i });
+    for (std::uint32_t i = 0; i < document.rectangles.count(); ++i) shapes.push_back({ ShapeKind::Rectangle, i });
+    for (std::uint32_t i = 0; i < document.circles.count(); ++i) shapes.push_back({ ShapeKind::Circle, i });
+    document.order.sort(shapes);
+    for (ShapeRef shape : shapes) bin(shape);
+}
+
+void SoftRasterizer::renderBand(const Document& document, std::size_t band, RasterImage& image, sf::Color background,
+    std::vector<sf::Vertex>& scratch) const {
+    int top = static_cast<int>(band * BAND_HEIGHT);
+    int bottom = std::min(top + static_cast<int>(BAND_HEIGHT), static_cast<int>(image.height));
+
+    std::uint8_t backgroundBytes[4] = { background.r, background.g, background.b, background.a };
+    for (int y = top; y < bottom; ++y) {
+        std::uint8_t* row = image.row(static_cast<unsigned int>(y));
+        for (unsigned int x = 0; x < image.width; ++x) std::memcpy(row + x * 4, backgroundBytes, 4);
+    }
+
+    auto toPoint = [&](const sf::Vertex& vertex) {
+        return Point{ (vertex.position.x - origin.x) * scale.x, (vertex.position.y - origin.y) * scale.y,
+            static_cast<float>(vertex.color.r), static_cast<float>(vertex.color.g),
+            static_cast<float>(vertex.color.b), static_cast<float>(vertex.color.a) };
+    };
+
+    for (ShapeRef shape : bands[band].shapes) {
+        scratch.clear();
+        switch (shape.kind) {
+        case ShapeKind::Line:
+            tessellateLine(document.lines[shape.index], scratch);
+            break;
+        case ShapeKind::Rectangle:
+            tessellateRectangle(document.rectangles, shape.index, scratch);
+            break;
+        case ShapeKind::Circle:
+            tessellateCircle(document.circles, shape.index, std::max(scale.x, scale.y), scratch);
+            break;
+        }
+
+        for (std::size_t i = 0; i + 2 < scratch.size(); i += 3) {
+            const sf::Vertex* v = &scratch[i];
+            bool flat = v[0].color == v[1].color && v[1].color == v[2].color;
+            rasterizeTriangle(image, toPoint(v[0]), toPoint(v[1]), toPoint(v[2]), top, bottom, flat, v[0].color);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "document.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plain RGBA8 pixel buffer, rows top to bottom, no padding.
+struct RasterImage {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<std::uint8_t> pixels;
+
+    void resize(unsigned int newWidth, unsigned int newHeight);
+    std::uint8_t* row(unsigned int y) { return pixels.data() + static_cast<std::size_t>(y) * width * 4; }
+};
+
+// Renders the document on the CPU, without a GL context. Shapes go through
+// the same tessellation as the GPU path and are filled span by span with
+// SFML's alpha blending, so the output matches what the window shows.
+// The image is cut into horizontal bands that are rendered in parallel;
+// every band gets the shapes that touch it, in document draw order.
+class SoftRasterizer {
+public:
+    static constexpr unsigned int BAND_HEIGHT = 64;
+
+    // 0 picks std::thread::hardware_concurrency().
+    void setThreadCount(unsigned int count) { threadCount = count; }
+
+    // Renders the world rectangle `area` of `document` into the whole of
+    // `image`, which must already have its final size.
+    void render(const Document& document, const sf::FloatRect& area, RasterImage& image,
+        sf::Color background = sf::Color::White);
+
+private:
+    struct Band {
+        std::vector<ShapeRef> shapes;
+    };
+
+    void binShapes(const Document& document, const sf::FloatRect& area, const RasterImage& image);
+    void renderBand(const Document& document, std::size_t band, RasterImage& image, sf::Color background,
+        std::vector<sf::Vertex>& scratch) const;
+
+    std::vector<Band> bands;
+    sf::Vector2f origin;
+    sf::Vector2f scale;
+    unsigned int threadCount = 0;
+};
@@ -0,0 +1,191 @@
+#include "spatial_index.h"
+#include "grid_key.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+float distanceTo(const sf::FloatRect& bounds, sf::Vector2f point) {
+    float dx = std::max({ bounds.position.x - point.x, 0.0f, point.x - (bounds.position.x + bounds.size.x) });
+    float dy = std::max({ bounds.position.y - point.y, 0.0f, point.y - (bounds.position.y + bounds.size.y) });
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+bool contains(const sf::FloatRect& bounds, sf::Vector2f point) {
+    return point.x >= bounds.position.x && point.x <= bounds.position.x + bounds.size.x &&
+        point.y >= bounds.position.y && point.y <= bounds.position.y + bounds.size.y;
+}
+}
+
+int SpatialIndex::cellCoord(float v) {
+    return static_cast<int>(std::floor(v / CELL_SIZE));
+}
+
+SpatialIndex::CellRange SpatialIndex::cellsCovering(const sf::FloatRect& bounds) {
+    return {
+        cellCoord(bounds.position.x),
+        cellCoord(bounds.position.y),
+        cellCoord(bounds.position.x + bounds.size.x),
+        cellCoord(bounds.position.y + bounds.size.y)
+    };
+}
+
+bool SpatialIndex::isLarge(const CellRange& range) {
+    long long cellsWide = static_cast<long long>(range.right) - range.left + 1;
+    long long cellsHigh = static_cast<long long>(range.bottom) - range.top + 1;
+    return cellsWide * cellsHigh > MAX_CELLS_PER_SHAPE;
+}
+
+const std::vector<SpatialIndex::Entry>* SpatialIndex::findCell(int x, int y) const {
+    auto it = cells.find(gridKey(x, y));
+    return it != cells.end() ? &it->second : nullptr;
+}
+
+void SpatialIndex::insert(ShapeHandle shape, const sf::FloatRect& bounds) {
+    ++shapeCount;
+    CellRange range = cellsCovering(bounds);
+    if (isLarge(range)) {
+        large.push_back({ bounds, shape });
+        return;
+    }
+
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            cells[gridKey(x, y)].push_back({ bounds, shape });
+        }
+    }
+
+    if (extent.right < extent.left) {
+        extent = range;
+    }
+    else {
+        extent.left = std::min(extent.left, range.left);
+        extent.top = std::min(extent.top, range.top);
+        extent.right = std::max(extent.right, range.right);
+        extent.bottom = std::max(extent.bottom, range.bottom);
+    }
+}
+
+void SpatialIndex::remove(ShapeHandle shape, const sf::FloatRect& bounds) {
+    auto erase = [shape](std::vector<Entry>& entries) {
+        auto it = std::find_if(entries.begin(), entries.end(), [shape](const Entry& e) { return e.shape == shape; });
+        if (it == entries.end()) return false;
+        *it = entries.back();
+        entries.pop_back();
+        return true;
+    };
+
+    CellRange range = cellsCovering(bounds);
+    if (isLarge(range)) {
+        if (erase(large)) --shapeCount;
+        return;
+    }
+
+    bool found = false;
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            auto it = cells.find(gridKey(x, y));
+            if (it == cells.end()) continue;
+            found = erase(it->second) || found;
+            if (it->second.empty()) cells.erase(it);
+        }
+    }
+    if (found) --shapeCount;
+}
+
+void SpatialIndex::clear() {
+    cells.clear();
+    large.clear();
+    extent = { 0, 0, -1, -1 };
+    shapeCount = 0;
+}
+
+void SpatialIndex::queryPoint(sf::Vector2f point, std::vector<ShapeHandle>& out) const {
+    for (const Entry& e : large) {
+        if (contains(e.bounds, point)) out.push_back(e.shape);
+    }
+
+    if (const auto* cell = findCell(cellCoord(point.x), cellCoord(point.y))) {
+        for (const Entry& e : *cell) {
+            if (contains(e.bounds, point)) out.push_back(e.shape);
+        }
+    }
+}
+
+void SpatialIndex::queryRect(const sf::FloatRect& area, std::vector<ShapeHandle>& out) const {
+    for (const Entry& e : large) {
+        if (intersects(e.bounds, area)) out.push_back(e.shape);
+    }
+
+    CellRange range = cellsCovering(area);
+    range.left = std::max(range.left, extent.left);
+    range.top = std::max(range.top, extent.top);
+    range.right = std::min(range.right, extent.right);
+    range.bottom = std::min(range.bottom, extent.bottom);
+
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            const auto* cell = findCell(x, y);
+            if (!cell) continue;
+            for (const Entry& e : *cell) {
+                if (!intersects(e.bounds, area)) continue;
+                // A shape listed in several cells is reported only from the
+                // cell holding the top-left corner of its overlap with `area`.
+                float left = std::max(e.bounds.position.x, area.position.x);
+                float top = std::max(e.bounds.position.y, area.position.y);
+                if (cellCoord(left) == x && cellCoord(top) == y) out.push_back(e.shape);
+            }
+        }
+    }
+}
+
+void SpatialIndex::queryNearest(sf::Vector2f point, std::size_t k, std::vector<ShapeHandle>& out) const {
+    if (k == 0 || shapeCount == 0) return;
+
+    struct Candidate {
+        float distance;
+        ShapeHandle shape;
+    };
+    auto farther = [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; };
+
+    // Max-heap of the best k so far. Shapes listed in several cells are
+    // deduplicated against it; once evicted they can never get back in.
+    std::vector<Candidate> best;
+    auto consider = [&](const Entry& e) {
+        float distance = distanceTo(e.bounds, point);
+        if (best.size() == k && distance >= best.front().distance) return;
+        for (const Candidate& c : best) {
+            if (c.shape == e.shape) return;
+        }
+        best.push_back({ distance, e.shape });
+        std::push_heap(best.begin(), best.end(), farther);
+        if (best.size() > k) {
+            std::pop_heap(best.begin(), best.end(), farther);
+            best.pop_back();
+        }
+    };
+
+    for (const Entry& e : large) consider(e);
+
+    // Search outwards ring by ring. Every cell in ring r + 1 is at least
+    // r * CELL_SIZE away, which bounds when the search can stop.
+    int cx = cellCoord(point.x);
+    int cy = cellCoord(point.y);
+    int maxRing = std::max({ cx - extent.left, extent.right - cx, cy - extent.top, extent.bottom - cy });
+    for (int r = 0; r <= maxRing; ++r) {
+        for (int y = cy - r; y <= cy + r; ++y) {
+            bool edgeRow = (y == cy - r || y == cy + r);
+            for (int x = cx - r; x <= cx + r; x += (edgeRow || r == 0) ? 1 : 2 * r) {
+                if (const auto* cell = findCell(x, y)) {
+                    for (const Entry& e : *cell) consider(e);
+                }
+            }
+        }
+        if (best.size() == k && best.front().distance <= r * CELL_SIZE) break;
+    }
+
+    std::sort_heap(best.begin(), best.end(), farther);
+    for (const Candidate& c : best) {
+        out.push_back(c.shape);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "shapes.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid over shape bounding boxes, updated incrementally as shapes
+// are committed. A shape is listed in every cell its bounds touch; shapes
+// that would touch too many cells are kept in a separate list instead.
+// Shapes are listed by handle, so erasing one leaves the others' entries
+// valid.
+class SpatialIndex {
+public:
+    static constexpr float CELL_SIZE = 256.0f;
+    static constexpr int MAX_CELLS_PER_SHAPE = 64;
+
+    void insert(ShapeHandle shape, const sf::FloatRect& bounds);
+    void remove(ShapeHandle shape, const sf::FloatRect& bounds);
+    void clear();
+    std::size_t size() const { return shapeCount; }
+
+    // Each query appends every matching shape exactly once to `out`.
+    void queryPoint(sf::Vector2f point, std::vector<ShapeHandle>& out) const;
+    void queryRect(const sf::FloatRect& area, std::vector<ShapeHandle>& out) const;
+    // The `k` shapes whose bounds are closest to `point`, nearest first.
+    void queryNearest(sf::Vector2f point, std::size_t k, std::vector<ShapeHandle>& out) const;
+
+private:
+    struct Entry {
+        sf::FloatRect bounds;
+        ShapeHandle shape;
+    };
+
+    struct CellRange {
+        int left, top, right, bottom;
+    };
+
+    static int cellCoord(float v);
+    static CellRange cellsCovering(const sf::FloatRect& bounds);
+    static bool isLarge(const CellRange& range);
+
+    const std::vector<Entry>* findCell(int x, int y) const;
+
+    std::unordered_map<std::uint64_t, std::vector<Entry>> cells;
+    std::vector<Entry> large;
+    CellRange extent{ 0, 0, -1, -1 };
+    std::size_t shapeCount = 0;
+};
@@ -0,0 +1,160 @@
+#include "tiled_canvas.h"
+#include "grid_key.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <utility>
+
+TiledCanvas::TiledCanvas(Redraw redraw)
+    : redraw(std::move(redraw)) {
+}
+
+void TiledCanvas::setScale(float pixelsPerUnit) {
+    if (pixelsPerUnit == scale) return;
+    scale = pixelsPerUnit;
+
+    for (auto& entry : tiles) {
+        recycle(std::move(entry.second));
+    }
+    tiles.clear();
+}
+
+void TiledCanvas::recycle(std::unique_ptr<Tile> tile) {
+    // Keep the render textures around; creating them is far more expensive
+    // than redrawing into them.
+    tile->stale = true;
+    tile->dirty = false;
+    if (freeTiles.size() < MAX_TILES) freeTiles.push_back(std::move(tile));
+}
+
+TiledCanvas::TileRange TiledCanvas::tilesCovering(const sf::FloatRect& bounds) const {
+    const float size = TILE_SIZE / scale;
+    TileRange range;
+    range.left = static_cast<int>(std::floor(bounds.position.x / size));
+    range.top = static_cast<int>(std::floor(bounds.position.y / size));
+    range.right = static_cast<int>(std::floor((bounds.position.x + bounds.size.x) / size));
+    range.bottom = static_cast<int>(std::floor((bounds.position.y + bounds.size.y) / size));
+    return range;
+}
+
+sf::FloatRect TiledCanvas::tileRect(int x, int y) const {
+    const float size = TILE_SIZE / scale;
+    return sf::FloatRect({ x * size, y * size }, { size, size });
+}
+
+TiledCanvas::Tile* TiledCanvas::findTile(int x, int y) const {
+    auto it = tiles.find(gridKey(x, y));
+    return it != tiles.end() ? it->second.get() : nullptr;
+}
+
+TiledCanvas::Tile* TiledCanvas::acquireTile(int x, int y) {
+    if (Tile* tile = findTile(x, y)) return tile;
+
+    std::unique_ptr<Tile> tile;
+    if (!freeTiles.empty()) {
+        tile = std::move(freeTiles.back());
+        freeTiles.pop_back();
+    }
+    else {
+        tile = std::make_unique<Tile>();
+        if (!tile->texture.resize({ TILE_SIZE, TILE_SIZE })) {
+            ready = false;
+            return nullptr;
+        }
+    }
+    tile->texture.setView(sf::View(tileRect(x, y)));
+
+    Tile* result = tile.get();
+    tiles.emplace(gridKey(x, y), std::move(tile));
+    return result;
+}
+
+void TiledCanvas::paint(const sf::FloatRect& bounds, const Painter& painter) {
+    TileRange range = tilesCovering(bounds);
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            Tile* tile = findTile(x, y);
+            // Missing and stale tiles get the shape on their full redraw.
+            if (!tile || tile->stale) continue;
+            painter(tile->texture);
+            tile->dirty = true;
+        }
+    }
+}
+
+void TiledCanvas::invalidate(const sf::FloatRect& bounds) {
+    TileRange range = tilesCovering(bounds);
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            if (Tile* tile = findTile(x, y)) tile->stale = true;
+        }
+    }
+}
+
+void TiledCanvas::invalidateAll() {
+    for (auto& entry : tiles) {
+        entry.second->stale = true;
+    }
+}
+
+void TiledCanvas::update(const sf::FloatRect& visible) {
+    if (!ready) return;
+
+    TileRange range = tilesCovering(visible);
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            Tile* tile = acquireTile(x, y);
+            if (!tile) return;
+            if (tile->stale) {
+                PROFILE_ZONE("TiledCanvas::redraw");
+                tile->texture.clear(sf::Color::White);
+                redraw(tile->texture, tileRect(x, y));
+                tile->stale = false;
+                tile->dirty = true;
+            }
+        }
+    }
+
+    flushedTiles = 0;
+    for (auto& entry : tiles) {
+        Tile& tile = *entry.second;
+        if (tile.dirty) {
+            tile.texture.display();
+            tile.dirty = false;
+            ++flushedTiles;
+        }
+    }
+
+    if (tiles.size() > MAX_TILES) evictOutside(range);
+}
+
+void TiledCanvas::evictOutside(const TileRange& keep) {
+    for (auto it = tiles.begin(); it != tiles.end();) {
+        int x = static_cast<int>(it->first >> 32);
+        int y = static_cast<int>(static_cast<std::int32_t>(it->first & 0xFFFFFFFF));
+        bool inside = x >= keep.left && x <= keep.right && y >= keep.top && y <= keep.bottom;
+        if (inside) {
+            ++it;
+        }
+        else {
+            recycle(std::move(it->second));
+            it = tiles.erase(it);
+        }
+    }
+}
+
+void TiledCanvas::present(sf::RenderTarget& target, const sf::FloatRect& visible) const {
+    TileRange range = tilesCovering(visible);
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            const Tile* tile = findTile(x, y);
+            if (!tile) continue;
+            sf::Sprite sprite(tile->texture.getTexture());
+            sprite.setPosition(tileRect(x, y).position);
+            sprite.setScale({ 1.0f / scale, 1.0f / scale });
+            // Tiles are opaque, so there is nothing to blend against.
+            target.draw(sprite, sf::RenderStates(sf::BlendNone));
+            Profiler::instance().countDraw(4);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// World-space raster cache split into fixed-size tiles. Tiles are allocated
+// lazily for the area that is actually shown. A committed shape is painted
+// only into the tiles its bounds touch, and only those tiles get flushed,
+// so an edit costs in proportion to its area instead of the canvas size.
+// Tiles are rasterized at the current view scale; changing the scale
+// recycles every tile.
+class TiledCanvas {
+public:
+    static constexpr int TILE_SIZE = 256;
+    static constexpr std::size_t MAX_TILES = 256;
+
+    using Painter = std::function<void(sf::RenderTarget&)>;
+    using Redraw = std::function<void(sf::RenderTarget&, const sf::FloatRect&)>;
+
+    // `redraw` paints the part of the document inside the given world rect;
+    // it is used for tiles that are new or were invalidated and therefore
+    // cannot be updated incrementally.
+    explicit TiledCanvas(Redraw redraw);
+
+    bool isReady() const { return ready; }
+
+    // Screen pixels per world unit.
+    void setScale(float pixelsPerUnit);
+    float getScale() const { return scale; }
+
+    void paint(const sf::FloatRect& bounds, const Painter& painter);
+    void invalidate(const sf::FloatRect& bounds);
+    void invalidateAll();
+
+    void update(const sf::FloatRect& visible);
+    void present(sf::RenderTarget& target, const sf::FloatRect& visible) const;
+
+    std::size_t getTileCount() const { return tiles.size(); }
+    std::size_t getFlushedTileCount() const { return flushedTiles; }
+
+private:
+    struct Tile {
+        sf::RenderTexture texture;
+        bool stale = true;
+        bool dirty = false;
+    };
+
+    struct TileRange {
+        int left, top, right, bottom;
+    };
+
+    TileRange tilesCovering(const sf::FloatRect& bounds) const;
+    sf::FloatRect tileRect(int x, int y) const;
+
+    Tile* findTile(int x, int y) const;
+    Tile* acquireTile(int x, int y);
+    void evictOutside(const TileRange& keep);
+    void recycle(std::unique_ptr<Tile> tile);
+
+    Redraw redraw;
+    float scale = 1.0f;
+    std::unordered_map<std::uint64_t, std::unique_ptr<Tile>> tiles;
+    std::vector<std::unique_ptr<Tile>> freeTiles;
+    std::size_t flushedTiles = 0;
+    bool ready = true;
+};
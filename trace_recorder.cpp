@@ -0,0 +1,70 @@
+#include "trace_recorder.h"
+
+#include <chrono>
+#include <cstdio>
+
+TraceRecorder::~TraceRecorder() {
+    stop();
+}
+
+bool TraceRecorder::start(const std::string& path) {
+    if (recording) return true;
+
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    // Only zones recorded from now on end up in the trace.
+    cursor = Profiler::instance().ring().position();
+    firstEvent = true;
+    eventCount = 0;
+    stopRequested = false;
+    recording = true;
+    worker = std::thread(&TraceRecorder::run, this);
+    return true;
+}
+
+void TraceRecorder::stop() {
+    if (!recording) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    worker.join();
+
+    out << "\n]}\n";
+    out.close();
+    recording = false;
+}
+
+void TraceRecorder::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+void TraceRecorder::drain() {
+    pending.clear();
+    Profiler::instance().ring().read(cursor, pending);
+    if (pending.empty()) return;
+
+    text.clear();
+    char line[256];
+    for (const ZoneEvent& event : pending) {
+        std::snprintf(line, sizeof(line),
+            "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"frame\":%u}}",
+            firstEvent ? "" : ",\n", event.name, event.beginNs / 1000.0, (event.endNs - event.beginNs) / 1000.0,
+            event.frame);
+        text += line;
+        firstEvent = false;
+    }
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out.flush();
+    eventCount.fetch_add(pending.size(), std::memory_order_relaxed);
+}
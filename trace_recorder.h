@@ -0,0 +1,45 @@
+#pragma once
+
+#include "profiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams profiler zones to a Chrome Trace Event JSON file (load it in
+// chrome://tracing or Perfetto). The main thread only pushes zones into the
+// profiler ring as usual; a background thread drains the ring, formats the
+// events and writes them out, so recording never stalls a frame.
+class TraceRecorder {
+public:
+    static constexpr int FLUSH_INTERVAL_MS = 50;
+
+    ~TraceRecorder();
+
+    bool start(const std::string& path);
+    void stop();
+    bool isRecording() const { return recording; }
+    std::uint64_t getEventCount() const { return eventCount.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void drain();
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopRequested = false;
+    bool recording = false;
+
+    std::ofstream out;
+    std::uint64_t cursor = 0;
+    std::vector<ZoneEvent> pending;
+    std::string text;
+    bool firstEvent = true;
+    std::atomic<std::uint64_t> eventCount{ 0 };
+};
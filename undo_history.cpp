@@ -0,0 +1,38 @@
+#include "undo_history.h"
+
+void UndoHistory::push(const EditCommand& command) {
+    commands.resize(cursor);
+    commands.push_back(command);
+    cursor = commands.size();
+    trim();
+}
+
+const EditCommand* UndoHistory::undo() {
+    if (!canUndo()) return nullptr;
+    return &commands[--cursor];
+}
+
+const EditCommand* UndoHistory::redo() {
+    if (!canRedo()) return nullptr;
+    return &commands[cursor++];
+}
+
+void UndoHistory::clear() {
+    commands.clear();
+    cursor = 0;
+}
+
+void UndoHistory::setMemoryBudget(std::size_t bytes) {
+    budget = bytes;
+    trim();
+}
+
+// Redo entries go first, since they are the least likely to be wanted;
+// after that the oldest undo steps.
+void UndoHistory::trim() {
+    while (getMemoryUsed() > budget && canRedo()) commands.pop_back();
+    while (getMemoryUsed() > budget && !commands.empty()) {
+        commands.pop_front();
+        --cursor;
+    }
+}
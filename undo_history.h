@@ -0,0 +1,60 @@
+#pragma once
+
+#include "shapes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// One reversible edit. Shapes are referred to by handle, which stays valid
+// across the erases and re-adds that stepping through the history causes.
+struct EditCommand {
+    enum class Type : std::uint8_t {
+        AddShape,
+        EraseShape,
+        MoveShape
+    };
+
+    Type type;
+    // AddShape, EraseShape: the shape's value.
+    ShapeData shape;
+    ShapeHandle handle;
+    // The shape directly below `handle` before and after the edit (none at
+    // the bottom). EraseShape only uses the first.
+    std::optional<ShapeHandle> belowBefore;
+    std::optional<ShapeHandle> belowAfter;
+};
+
+// Undo/redo stack of edit commands. A command records the change, not the
+// document around it, so stepping either way costs the size of one edit
+// however large the document is. Once the history outgrows its memory
+// budget the oldest commands are forgotten.
+class UndoHistory {
+public:
+    static constexpr std::size_t DEFAULT_BUDGET_BYTES = 32 << 20;
+
+    // Records an edit that was just applied; anything that could be redone
+    // is dropped.
+    void push(const EditCommand& command);
+    // The command to revert or reapply, or nullptr at either end.
+    const EditCommand* undo();
+    const EditCommand* redo();
+    void clear();
+
+    bool canUndo() const { return cursor > 0; }
+    bool canRedo() const { return cursor < commands.size(); }
+    std::size_t size() const { return commands.size(); }
+
+    void setMemoryBudget(std::size_t bytes);
+    std::size_t getMemoryBudget() const { return budget; }
+    std::size_t getMemoryUsed() const { return commands.size() * sizeof(EditCommand); }
+
+private:
+    void trim();
+
+    std::deque<EditCommand> commands;
+    // Commands before the cursor can be undone, the rest redone.
+    std::size_t cursor = 0;
+    std::size_t budget = DEFAULT_BUDGET_BYTES;
+};